@@ -17,5 +17,13 @@ P1=$!
 nethogs -v 3 -t | adddate >> lcrail-nethogs-$1.txt &
 P2=$!
 
-# Wait until both background processes are killed when we kill our script
-wait $P1 $P2
+# Snapshot the metrics published by LCRail on D-Bus every 10 seconds
+while true; do
+    dbus-send --session --print-reply --dest=harbour.lcrail /metrics harbour.lcrail.Metrics.snapshot 2> /dev/null \
+        | grep string | adddate >> lcrail-metrics-$1.txt
+    sleep 10
+done &
+P3=$!
+
+# Wait until all background processes are killed when we kill our script
+wait $P1 $P2 $P3
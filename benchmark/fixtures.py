@@ -0,0 +1,239 @@
+#!/bin/python
+# Dylan Van Assche - LCRail benchmark
+# Record/replay HTTP proxy for deterministic offline benchmarks.
+#
+# Usage:
+#   python3 fixtures.py record fixtures/liveboard-brussels
+#   python3 fixtures.py replay fixtures/liveboard-brussels [--latency 150 | --original-timing]
+#
+# Start LCRail (or lcrail-benchmark) with LCRAIL_PROXY=http://<host>:<port> so every
+# Linked Connections page and realtime event stream goes through this proxy.
+# Only plain HTTP requests can be recorded. HTTPS is tunneled while recording but can't be
+# inspected, LCRAIL_SERVER=http://lc.dylanvanassche.be/sncb keeps LCRail's own requests on HTTP.
+import argparse
+import hashlib
+import json
+import os
+import selectors
+import socket
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qsl, urlencode, urlsplit, urlunsplit
+
+HOP_BY_HOP_HEADERS = {"connection", "keep-alive", "proxy-authenticate", "proxy-authorization",
+                      "te", "trailers", "transfer-encoding", "upgrade", "content-length",
+                      "content-encoding"}
+EVENT_STREAM = "text/event-stream"
+INDEX_FILE = "index.json"
+
+
+def normalize_url(url):
+    # Query parameters in a stable order, so replay doesn't depend on their order
+    parts = urlsplit(url)
+    query = urlencode(sorted(parse_qsl(parts.query, keep_blank_values=True)))
+    return urlunsplit((parts.scheme, parts.netloc, parts.path, query, ""))
+
+
+class Fixtures:
+    def __init__(self, path):
+        self._path = path
+        self._lock = threading.Lock()
+        self._entries = {}
+        self._start = time.time()
+        os.makedirs(os.path.join(path, "bodies"), exist_ok=True)
+
+    def load(self):
+        with open(os.path.join(self._path, INDEX_FILE), "r") as f:
+            for entry in json.load(f):
+                self._entries[entry["url"]] = entry
+        print("Loaded {} fixtures from {}".format(len(self._entries), self._path))
+
+    def save(self):
+        with self._lock:
+            with open(os.path.join(self._path, INDEX_FILE), "w") as f:
+                json.dump(list(self._entries.values()), f, indent=2)
+
+    def add(self, url, status, headers, body, started, duration, events=None):
+        name = hashlib.sha1(url.encode("utf-8")).hexdigest()
+        with open(os.path.join(self._path, "bodies", name), "wb") as f:
+            f.write(body)
+        with self._lock:
+            self._entries[url] = {
+                                    "url": url,
+                                    "status": status,
+                                    "headers": headers,
+                                    "body": name,
+                                    "started": started,
+                                    "duration": duration,
+                                    "events": events or []
+                                 }
+        self.save()
+
+    def get(self, url):
+        return self._entries.get(url)
+
+    def body(self, entry):
+        with open(os.path.join(self._path, "bodies", entry["body"]), "rb") as f:
+            return f.read()
+
+    @property
+    def elapsed(self):
+        return time.time() - self._start
+
+
+class ProxyHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    fixtures = None
+    replay = False
+    latency = 0.0
+    original_timing = False
+
+    def do_GET(self):
+        url = normalize_url(self.path)
+        if self.replay:
+            self.replay_request(url)
+        else:
+            self.record_request(url)
+
+    def do_CONNECT(self):
+        # HTTPS can't be inspected: tunneled while recording so the app keeps working, never recorded
+        if self.replay:
+            self.send_error(501, "HTTPS can't be replayed, use plain HTTP (LCRAIL_SERVER)")
+            return
+        host, _, port = self.path.rpartition(":")
+        try:
+            upstream = socket.create_connection((host, int(port)))
+        except (OSError, ValueError) as e:
+            self.send_error(502, "Unable to tunnel to {}: {}".format(self.path, e))
+            return
+        self.send_response(200, "Connection Established")
+        self.end_headers()
+        sys.stderr.write("{:.3f}s Tunneling {}, not recorded\n".format(self.fixtures.elapsed, self.path))
+        self.tunnel(upstream)
+        self.close_connection = True
+
+    def tunnel(self, upstream):
+        # Relay both directions until one side closes the connection
+        selector = selectors.DefaultSelector()
+        selector.register(self.connection, selectors.EVENT_READ, upstream)
+        selector.register(upstream, selectors.EVENT_READ, self.connection)
+        try:
+            while True:
+                for key, _ in selector.select():
+                    data = key.fileobj.recv(64 * 1024)
+                    if not data:
+                        return
+                    key.data.sendall(data)
+        except OSError:
+            pass
+        finally:
+            selector.close()
+            upstream.close()
+
+    def log_message(self, format, *args):
+        sys.stderr.write("{:.3f}s {}\n".format(self.fixtures.elapsed, format % args))
+
+    def send_headers(self, status, headers, length=None):
+        self.send_response(status)
+        for name, value in headers:
+            if name.lower() not in HOP_BY_HOP_HEADERS:
+                self.send_header(name, value)
+        if length is not None:
+            self.send_header("Content-Length", str(length))
+        else:
+            self.send_header("Connection", "close")
+        self.end_headers()
+
+    def record_request(self, url):
+        started = self.fixtures.elapsed
+        headers = {k: v for k, v in self.headers.items() if k.lower() not in HOP_BY_HOP_HEADERS}
+        headers.pop("Accept-Encoding", None)
+        request = urllib.request.Request(self.path, headers=headers)
+        try:
+            response = urllib.request.urlopen(request)
+        except urllib.error.HTTPError as e:
+            response = e
+        response_headers = list(response.headers.items())
+
+        # Realtime event streams are forwarded line by line and every event is timestamped
+        if EVENT_STREAM in response.headers.get("Content-Type", ""):
+            self.send_headers(response.status, response_headers)
+            events = []
+            data = []
+            try:
+                for line in response:
+                    self.wfile.write(line)
+                    self.wfile.flush()
+                    data.append(line.decode("utf-8"))
+                    if line.strip() == b"":
+                        events.append({"t": self.fixtures.elapsed - started, "data": "".join(data)})
+                        data = []
+            except (BrokenPipeError, ConnectionResetError):
+                pass
+            self.fixtures.add(url, response.status, response_headers, b"", started,
+                              self.fixtures.elapsed - started, events)
+            return
+
+        body = response.read()
+        duration = self.fixtures.elapsed - started
+        self.fixtures.add(url, response.status, response_headers, body, started, duration)
+        self.send_headers(response.status, response_headers, len(body))
+        self.wfile.write(body)
+
+    def replay_request(self, url):
+        entry = self.fixtures.get(url)
+        if entry is None:
+            self.send_error(404, "No fixture recorded for {}".format(url))
+            return
+
+        # Either the recorded server time or a fixed latency
+        time.sleep(entry["duration"] if self.original_timing and not entry["events"] else self.latency)
+
+        if entry["events"]:
+            self.send_headers(entry["status"], entry["headers"])
+            previous = 0.0
+            try:
+                for event in entry["events"]:
+                    time.sleep(max(0.0, event["t"] - previous) if self.original_timing else self.latency)
+                    previous = event["t"]
+                    self.wfile.write(event["data"].encode("utf-8"))
+                    self.wfile.flush()
+            except (BrokenPipeError, ConnectionResetError):
+                pass
+            return
+
+        body = self.fixtures.body(entry)
+        self.send_headers(entry["status"], entry["headers"], len(body))
+        self.wfile.write(body)
+
+
+if __name__ == "__main__":
+    # Parse arguments
+    parser = argparse.ArgumentParser(description="LCRail record/replay fixture proxy.")
+    parser.add_argument("mode", choices=["record", "replay"], help="Record live traffic or replay it")
+    parser.add_argument("path", type=str, help="Directory of the fixtures")
+    parser.add_argument("--host", type=str, default="127.0.0.1", help="Listen address (default: 127.0.0.1)")
+    parser.add_argument("--port", type=int, default=8080, help="Listen port (default: 8080)")
+    parser.add_argument("--latency", type=float, default=0.0,
+                        help="Replay: fixed latency in ms for every page and event (default: 0)")
+    parser.add_argument("--original-timing", action="store_true",
+                        help="Replay: use the recorded server and event timing")
+    args = parser.parse_args()
+
+    ProxyHandler.fixtures = Fixtures(args.path)
+    ProxyHandler.replay = args.mode == "replay"
+    ProxyHandler.latency = args.latency / 1000.0
+    ProxyHandler.original_timing = args.original_timing
+    if ProxyHandler.replay:
+        ProxyHandler.fixtures.load()
+
+    server = ThreadingHTTPServer((args.host, args.port), ProxyHandler)
+    print("{} proxy listening on {}:{}".format(args.mode.capitalize(), args.host, args.port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        server.server_close()
@@ -2,7 +2,7 @@
 import argparse
 import glob
 import sys
-from parser import TopParser, NethogsParser, UserInformedTimeParser
+from parser import TopParser, NethogsParser, MetricsParser, UserInformedTimeParser
 from plot import Plotter
 
 class Main():
@@ -46,6 +46,15 @@ class Main():
                                                             "mem": top.mem,
                                                             "timeline": top.timeline
                                                        }
+            # Metrics file
+            elif "metrics" in path:
+                metrics = MetricsParser(path)
+                metrics.parse()
+                self._data[benchmark][part][device]["metrics"] = {
+                                                                "snapshots": metrics.snapshots,
+                                                                "totals": metrics.last,
+                                                                "timeline": metrics.timeline
+                                                             }
             # User Informed Time file
             else:
                 user_informed_time = UserInformedTimeParser(path)
@@ -1,5 +1,7 @@
 #!/bin/python
+import json
 import statistics
+import sys
 from datetime import datetime
 
 
@@ -84,6 +86,31 @@ class TopParser(BaseParser):
     def mem(self):
         return self._mem
 
+class MetricsParser(BaseParser):
+    def __init__(self, input_file):
+        super().__init__(input_file)
+        self._snapshots = []
+
+    def parse(self):
+        # Lines from the LCRAIL_METRICS dump or D-Bus snapshots: <date> string "<json>"
+        for line in self._lines:
+            try:
+                snapshot = json.loads(line[line.index("{"):line.rindex("}") + 1])
+                self._snapshots.append(snapshot)
+                self._timestamps.append(snapshot["timestamp"] / 1000.0)
+            except ValueError:
+                pass # Ignore incomplete lines
+        self.convert_timestamps()
+
+    @property
+    def snapshots(self):
+        return self._snapshots
+
+    @property
+    def last(self):
+        # Counters and histograms are cumulative, the last snapshot has the totals
+        return self._snapshots[-1] if self._snapshots else {}
+
 class UserInformedTimeParser(BaseParser):
     def __init__(self, input_file):
         super().__init__(input_file)
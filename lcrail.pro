@@ -32,7 +32,24 @@ SOURCES += src/lcrail.cpp \
     src/models/stations.cpp \
     src/models/router.cpp \
     src/models/trip.cpp \
-    src/sailfishos.cpp
+    src/models/stationindex.cpp \
+    src/models/stationgrid.cpp \
+    src/models/stationdensity.cpp \
+    src/network/network.cpp \
+    src/network/pagecache.cpp \
+    src/network/connectionpage.cpp \
+    src/network/prefetcher.cpp \
+    src/network/server.cpp \
+    src/network/realtime.cpp \
+    src/network/trafficmeter.cpp \
+    src/sessions/liveboardsession.cpp \
+    src/sessions/routersession.cpp \
+    src/tracing/tracer.cpp \
+    src/tracing/frametracer.cpp \
+    src/metrics/metrics.cpp \
+    src/sailfishos.cpp \
+    src/notificationscheduler.cpp \
+    src/logging.cpp
 
 # Enable GCOV coverage reports (https://medium.com/@kelvin_sp/generating-code-coverage-with-qt-5-and-gcov-on-mac-os-4999857f4676)
 # --coverage option is synonym for: -fprofile-arcs -ftest-coverage -lgcov
@@ -157,4 +174,65 @@ HEADERS += \
     src/models/stations.h \
     src/models/router.h \
     src/models/trip.h \
-    src/sailfishos.h
+    src/models/stationindex.h \
+    src/models/stationgrid.h \
+    src/models/stationdensity.h \
+    src/network/network.h \
+    src/network/pagecache.h \
+    src/network/connectionpage.h \
+    src/network/prefetcher.h \
+    src/network/server.h \
+    src/network/realtime.h \
+    src/network/trafficmeter.h \
+    src/sessions/liveboardsession.h \
+    src/sessions/routersession.h \
+    src/tracing/tracer.h \
+    src/tracing/frametracer.h \
+    src/metrics/metrics.h \
+    src/sailfishos.h \
+    src/notificationscheduler.h \
+    src/logging.h
+
+# Model tests: qmake CONFIG+=tests && make check
+# Same headless build as the benchmark with the Qt Test runner as main.
+CONFIG(tests) {
+    TARGET = lcrail-tests
+    QT += testlib
+    CONFIG -= sailfishapp sailfishapp_i18n
+    CONFIG += console testcase
+    PKGCONFIG -= nemonotifications-qt5
+    DEFINES += LCRAIL_HEADLESS
+    SOURCES -= src/lcrail.cpp src/tracing/frametracer.cpp
+    HEADERS -= src/tracing/frametracer.h
+    SOURCES += tests/main.cpp \
+        tests/testliveboard.cpp \
+        tests/testrouter.cpp \
+        tests/testsessions.cpp \
+        tests/teststationindex.cpp \
+        tests/testconnectionpage.cpp
+    HEADERS += tests/testliveboard.h \
+        tests/testrouter.h \
+        tests/testsessions.h \
+        tests/teststationindex.h \
+        tests/testconnectionpage.h
+}
+
+# Tracing spans: qmake CONFIG+=tracing, run with LCRAIL_TRACE=<trace.json>
+CONFIG(tracing) {
+    DEFINES += LCRAIL_TRACING
+}
+
+# Headless benchmark build: qmake CONFIG+=benchmark
+# Drives the models without the Sailfish UI and notifications so they can be benchmarked on any Linux machine.
+CONFIG(benchmark) {
+    TARGET = lcrail-benchmark
+    CONFIG -= sailfishapp sailfishapp_i18n
+    CONFIG += console
+    PKGCONFIG -= nemonotifications-qt5
+    DEFINES += LCRAIL_HEADLESS
+    SOURCES -= src/lcrail.cpp src/tracing/frametracer.cpp
+    HEADERS -= src/tracing/frametracer.h
+    SOURCES += src/benchmark/main.cpp \
+        src/benchmark/benchmark.cpp
+    HEADERS += src/benchmark/benchmark.h
+}
@@ -17,6 +17,9 @@
 
 import QtQuick 2.2
 import Sailfish.Silica 1.0
+import LCRail.Views.Stations 1.0
+import LCRail.Network 1.0
+import "../js/utils.js" as Utils
 
 Column {
     width: parent.width
@@ -27,8 +30,57 @@ Column {
     property string _toURI
     property string _toName: "To"
 
+    property bool active: true // positioning only runs while the selector is shown
+    property bool _locating: active && _fromURI.length === 0 && !nearbyTimeout.expired
+
     signal selected(string fromURI, string toURI)
 
+    // The pages don't depend on the stations, prefetching starts while the user fills in the form
+    on_FromURIChanged: {
+        if(_fromURI.length > 0) {
+            prefetcher.prefetch(Utils.departureTime())
+        }
+    }
+
+    Prefetcher {
+        id: prefetcher
+    }
+
+    // Default departure station: the nearest one
+    on_LocatingChanged: {
+        if(_locating) {
+            nearby.startNearbyUpdates(1)
+        }
+        else {
+            nearby.stopNearbyUpdates()
+        }
+    }
+
+    StationsSearch {
+        id: nearby
+        Component.onCompleted: {
+            if(_locating) {
+                nearby.startNearbyUpdates(1)
+            }
+        }
+        Component.onDestruction: nearby.stopNearbyUpdates()
+        onNearestStationChanged: {
+            if(_fromURI.length === 0 && nearestStationURI.length > 0) {
+                _fromURI = nearestStationURI
+                _fromName = nearestStationName
+            }
+        }
+    }
+
+    // No fix in time: the user picks the station, positioning drains the battery
+    Timer {
+        id: nearbyTimeout
+        property bool expired: false
+        interval: 30000 // ms
+        running: _locating
+        onTriggered: expired = true
+    }
+
     Row {
         width: parent.width
 
@@ -23,7 +23,7 @@ import Sailfish.Silica 1.0
 import "../../js/utils.js" as Utils
 
 ListItem {
-    property date scheduledTime
+    property string scheduledTime
     property int delay
     property bool hasDelay
     property string platform
@@ -42,7 +42,7 @@ ListItem {
         truncationMode: TruncationMode.Fade
         font.bold: true
         color: yellow
-        text: scheduledTime.toLocaleTimeString(Qt.locale(), "HH:mm")
+        text: scheduledTime
     }
 
     Label {
@@ -51,6 +51,7 @@ ListItem {
             onLoaded: {
                 //loader.item.width = ListView.view.width
                 loader.item.time = model.time
+                loader.item.timeText = model.timeText
                 loader.item.delay = model.delay
                 loader.item.station = model.station
                 loader.item.platform = "?"
@@ -21,6 +21,7 @@ import "../../js/utils.js" as Utils
 
 ListItem {
     property date time
+    property string timeText
     property int delay
     property string color
     property string station
@@ -63,7 +64,7 @@ ListItem {
                     horizontalCenter: indicator.delay > 0? parent.horizontalCenter: undefined
                 }
                 font.bold: true
-                text: indicator.time.toLocaleTimeString(Qt.locale(), "HH:mm")
+                text: indicator.timeText
             }
 
             Label {
@@ -23,6 +23,7 @@ ListItem {
     property bool isFirstItem: false
     property bool isLastItem: false
     property date time
+    property string timeText
     property int delay
     property string station
     property string platform
@@ -96,7 +97,7 @@ ListItem {
             Label {
                 anchors.horizontalCenter: parent.horizontalCenter
                 font.capitalization: Font.SmallCaps
-                text: indicator.time.toLocaleTimeString(Qt.locale(), "HH:mm")
+                text: indicator.timeText
             }
 
             Label {
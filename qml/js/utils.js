@@ -39,3 +39,15 @@ function filterId(id) {
     var filterRegex = /^(S[0-9]{4})|(ICE[0-9]{4})|(THA[0-9]{4})|(IC[0-9]{3,4})|(EUR[0-9]{4})|(TGV[0-9]{4})|(P[0-9]{3,4})|(L[0-9]{3,4})|(EXTRA[0-9]{5})|(BUS[0-9]{5})/;
     return filterRegex.exec(id)[0];
 }
+
+function departureTime() {
+    var time = new Date();
+    time.setFullYear(2019); // Reproduction data 31/03/2019 14:00:00.000Z
+    time.setMonth(2);
+    time.setDate(31);
+    time.setHours(14);
+    time.setMinutes(0);
+    time.setSeconds(0);
+    time.setMilliseconds(0);
+    return time;
+}
@@ -21,6 +21,8 @@ import "../components"
 import LCRail.Views.Liveboard 1.0
 
 Page {
+    id: page
+
     SilicaFlickable {
         anchors.fill: parent
         contentHeight: column.height
@@ -36,6 +38,7 @@ Page {
             }
 
             ConnectionSelector {
+                active: page.status === PageStatus.Active && Qt.application.active
                 onSelected: pageStack.push(Qt.resolvedUrl("../pages/RouterPage.qml"),
                                            {
                                                from: fromURI,
@@ -20,6 +20,8 @@ import "../components"
 import "../components/liveboard"
 import Sailfish.Silica 1.0
 import LCRail.Views.Liveboard 1.0
+import LCRail.Views.Stations 1.0
+import "../js/utils.js" as Utils
 
 Page {
     property int _benchmarkTime
@@ -29,9 +31,13 @@ Page {
     // For performance reasons we wait until the Page is fully loaded before doing an API request
     onStatusChanged: {
             if(status === PageStatus.Active) {
+                if(_stationURI.length === 0) {
+                    nearby.startNearbyUpdates(1) // Back without a station, keep looking for the nearest one
+                }
                 getData();
             }
             else if(status === PageStatus.Deactivating) {
+                nearby.stopNearbyUpdates() // No GPS while the page isn't shown
                 liveboard.abortCurrentOperation();
             }
     }
@@ -41,20 +47,29 @@ Page {
             header.title = "Loading ...";
             liveboard.abortCurrentOperation();
             liveboard.clearBoard();
-            var departureTime = new Date();
-            departureTime.setFullYear(2019); // Reproduction data 31/03/2019
-            departureTime.setMonth(2);
-            departureTime.setDate(31);
-            departureTime.setHours(14); // 14:00:00.000Z
-            departureTime.setMinutes(0);
-            departureTime.setSeconds(0);
-            departureTime.setMilliseconds(0);
+            var departureTime = Utils.departureTime();
             console.debug("Fetching liveboard of:" + departureTime.toISOString());
             console.warn("$,liveboard," + new Date());
             liveboard.getBoard(_stationURI, departureTime);
         }
     }
 
+    // Default station: the nearest one until the user selects a station
+    StationsSearch {
+        id: nearby
+        Component.onCompleted: nearby.startNearbyUpdates(1)
+        onNearestStationChanged: {
+            if(_stationURI.length === 0 && nearestStationURI.length > 0) {
+                _stationURI = nearestStationURI
+                _stationName = nearestStationName
+                nearby.stopNearbyUpdates()
+                if(status === PageStatus.Active) {
+                    getData();
+                }
+            }
+        }
+    }
+
     LiveboardHeader {
         id: header
         anchors {
@@ -63,10 +78,12 @@ Page {
         }
         opacity: 0.9
         onSelectStation: {
+            nearby.stopNearbyUpdates() // The user picks the station
             var _page = pageStack.push(Qt.resolvedUrl("StationSelectorPage.qml"));
             _page.selected.connect(function(uri, name) {
                 _stationURI = uri
                 _stationName = name
+                liveboard.prefetch(Utils.departureTime(), uri) // Warm the pages during the page transition
                 // Page is automatically updated due statusChanged
             });
         }
@@ -84,9 +101,21 @@ Page {
             bottom: parent.bottom
         }
         clip: true // Paint only within defined borders
+        onContentYChanged: {
+            // Warm the adjacent windows before the user reaches either end of the board
+            if(liveboard.valid && !liveboard.busy) {
+                if(contentY > _previousContentY && visibleArea.yPosition + visibleArea.heightRatio > 0.8) {
+                    liveboard.prefetchNext();
+                }
+                else if(contentY < _previousContentY && visibleArea.yPosition < 0.2) {
+                    liveboard.prefetchPrevious();
+                }
+            }
+            _previousContentY = contentY;
+        }
         delegate: LiveboardDelegate {
             width: ListView.view.width
-            scheduledTime: model.departureTime
+            scheduledTime: model.departureTimeText
             delay: model.departureDelay
             hasDelay: model.hasDelay
             platform: model.platform
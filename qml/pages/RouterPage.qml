@@ -41,14 +41,7 @@ Page {
         console.log("Fetching connections")
         console.warn("$,router," + new Date());
         if(from.length > 0 && to.length > 0) {
-            var departureTime = new Date();
-            departureTime.setFullYear(2019); // 31/3/2019 14:00:00.000Z
-            departureTime.setMonth(2);
-            departureTime.setDate(31);
-            departureTime.setHours(14);
-            departureTime.setMinutes(0);
-            departureTime.setSeconds(0);
-            departureTime.setMilliseconds(0);
+            var departureTime = Utils.departureTime();
             console.log("ROUTER QML:" + departureTime);
             router.getConnections(from, to, departureTime, maxTransfers);
         }
@@ -93,5 +86,23 @@ Page {
                 VerticalScrollDecorator {}
             }
         }
+
+        PullDownMenu {
+            visible: !router.busy && connectionsListView.count > 0
+
+            MenuItem {
+                text: "Earlier";
+                onClicked: router.loadPrevious();
+            }
+        }
+
+        PushUpMenu {
+            visible: !router.busy && connectionsListView.count > 0
+
+            MenuItem {
+                text: "Later";
+                onClicked: router.loadNext();
+            }
+        }
     }
 }
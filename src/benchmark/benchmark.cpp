@@ -0,0 +1,300 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "benchmark.h"
+
+Benchmark::Benchmark(QObject *parent) : QObject(parent)
+{
+    m_liveboard = new Liveboard(this);
+    m_router = new Router(this);
+    m_stations = new Stations(this);
+
+    // First result: first row in the model, full result: model no longer busy
+    connect(m_liveboard, SIGNAL(rowsInserted(QModelIndex, int, int)), this, SLOT(handleRowsInserted()));
+    connect(m_liveboard, SIGNAL(busyChanged()), this, SLOT(handleBusyChanged()));
+    connect(m_liveboard, SIGNAL(benchmark(qint64)), this, SLOT(handleBenchmark(qint64)));
+    connect(m_router, SIGNAL(rowsInserted(QModelIndex, int, int)), this, SLOT(handleRowsInserted()));
+    connect(m_router, SIGNAL(busyChanged()), this, SLOT(handleBusyChanged()));
+    connect(m_router, SIGNAL(benchmark(qint64)), this, SLOT(handleBenchmark(qint64)));
+    connect(m_stations, SIGNAL(stationsUpdated()), this, SLOT(handleRowsInserted()));
+    connect(m_stations, SIGNAL(busyChanged()), this, SLOT(handleBusyChanged()));
+
+    m_timeout = new QTimer(this);
+    m_timeout->setSingleShot(true);
+    connect(m_timeout, SIGNAL(timeout()), this, SLOT(handleTimeout()));
+    m_updatesWindow = new QTimer(this);
+    m_updatesWindow->setSingleShot(true);
+    connect(m_updatesWindow, SIGNAL(timeout()), this, SLOT(handleUpdatesFinished()));
+
+    // Init variables
+    m_running = false;
+    m_firstResult = false;
+    m_waitingForUpdates = false;
+    m_draining = false;
+    m_failed = false;
+    m_maxTransfers = 4;
+    m_updatesWait = 0;
+}
+
+bool Benchmark::parseArguments(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless LCRail benchmark, reports p50/p95/p99 latencies of the models");
+    parser.addHelpOption();
+    QCommandLineOption liveboardOption("liveboard", "Liveboard of the station <uri>, can be repeated.", "uri");
+    QCommandLineOption routeOption("route", "Route between <from>,<to> station URIs, can be repeated.", "from,to");
+    QCommandLineOption stationOption("station", "Search stations by <name>, can be repeated.", "name");
+    QCommandLineOption departureOption("departure", "Departure time in ISO 8601 (default: reproduction data of 31/03/2019).",
+                                       "time", "2019-03-31T14:00:00.000Z");
+    QCommandLineOption iterationsOption("iterations", "Number of times every query is repeated (default: 10).", "n", "10");
+    QCommandLineOption transfersOption("max-transfers", "Maximum transfers for routes (default: 4).", "n", "4");
+    QCommandLineOption updatesOption("updates", "Seconds to wait for realtime updates after every query (default: 0).",
+                                     "seconds", "0");
+    QCommandLineOption timeoutOption("timeout", "Seconds before a query is considered failed (default: 120).",
+                                     "seconds", "120");
+    parser.addOption(liveboardOption);
+    parser.addOption(routeOption);
+    parser.addOption(stationOption);
+    parser.addOption(departureOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(transfersOption);
+    parser.addOption(updatesOption);
+    parser.addOption(timeoutOption);
+    parser.process(arguments);
+
+    m_departureTime = QDateTime::fromString(parser.value(departureOption), Qt::ISODate);
+    m_maxTransfers = parser.value(transfersOption).toUShort();
+    m_updatesWait = parser.value(updatesOption).toInt();
+    m_timeout->setInterval(parser.value(timeoutOption).toInt() * 1000);
+    const qint32 iterations = qMax(1, parser.value(iterationsOption).toInt());
+    if (!m_departureTime.isValid()) {
+        qCritical() << "Invalid departure time:" << parser.value(departureOption);
+        return false;
+    }
+
+    QList<Job> script;
+    foreach (const QString &uri, parser.values(liveboardOption)) {
+        Job job = { LiveboardQuery, "liveboard " + uri.section("/", -1), QStringList() << uri };
+        script.append(job);
+    }
+    foreach (const QString &route, parser.values(routeOption)) {
+        const QStringList stations = route.split(",");
+        if (stations.length() != 2) {
+            qCritical() << "Invalid route, expected <from>,<to>:" << route;
+            return false;
+        }
+        Job job = { RouterQuery, "route " + stations.at(0).section("/", -1) + "-" + stations.at(1).section("/", -1), stations };
+        script.append(job);
+    }
+    foreach (const QString &name, parser.values(stationOption)) {
+        Job job = { StationQuery, "station " + name, QStringList() << name };
+        script.append(job);
+    }
+    if (script.isEmpty()) {
+        qCritical() << "No queries given, use --liveboard, --route or --station";
+        return false;
+    }
+
+    for (qint32 i = 0; i < iterations; i++) {
+        foreach (const Job &job, script) {
+            m_jobs.enqueue(job);
+        }
+    }
+    return true;
+}
+
+bool Benchmark::hasFailed() const
+{
+    return m_failed;
+}
+
+void Benchmark::run()
+{
+    this->runNext();
+}
+
+void Benchmark::runNext()
+{
+    if (m_jobs.isEmpty()) {
+        this->report();
+        emit this->done();
+        return;
+    }
+
+    m_job = m_jobs.dequeue();
+
+    // A model stuck busy ignores the query, the job would only time out and skew the results
+    if (m_liveboard->isBusy() || m_router->isBusy() || m_stations->busy()) {
+        this->fail("Model still busy at the start of: " + m_job.name);
+        return;
+    }
+    this->reset();
+
+    m_running = true;
+    m_firstResult = false;
+    m_timeout->start();
+    m_timer.start();
+
+    switch (m_job.kind) {
+    case LiveboardQuery:
+        m_liveboard->getBoard(QUrl(m_job.arguments.at(0)), m_departureTime);
+        break;
+    case RouterQuery:
+        m_router->getConnections(m_job.arguments.at(0), m_job.arguments.at(1), m_departureTime, m_maxTransfers);
+        break;
+    case StationQuery:
+        m_stations->searchByName(m_job.arguments.at(0));
+        break;
+    }
+}
+
+void Benchmark::handleRowsInserted()
+{
+    if (m_running && !m_firstResult) {
+        m_firstResult = true;
+        this->record("first result", m_timer.elapsed());
+    }
+}
+
+bool Benchmark::isBusy() const
+{
+    // Only the model of the current job matters
+    return m_job.kind == LiveboardQuery ? m_liveboard->isBusy()
+         : m_job.kind == RouterQuery ? m_router->isBusy()
+         : m_stations->busy();
+}
+
+void Benchmark::reset()
+{
+    // Every job starts from empty models without watches, updates of earlier jobs can't leak in
+    m_updatesWindow->stop();
+    m_waitingForUpdates = false;
+    m_draining = false;
+    m_liveboard->abortCurrentOperation();
+    m_liveboard->clearBoard();
+    m_router->abortCurrentOperation();
+    m_router->clearRoutes();
+}
+
+void Benchmark::fail(const QString &reason)
+{
+    qCritical() << reason;
+    m_failed = true;
+    m_running = false;
+    m_timeout->stop();
+    m_jobs.clear();
+    this->reset();
+    this->report();
+    emit this->done();
+}
+
+void Benchmark::handleBusyChanged()
+{
+    // An update still running when the window closed finished, continue with the next job
+    if (m_draining && !this->isBusy()) {
+        m_draining = false;
+        m_timeout->stop();
+        QTimer::singleShot(0, this, SLOT(runNext()));
+        return;
+    }
+
+    if (!m_running) {
+        return;
+    }
+
+    if (!this->isBusy()) {
+        this->handleRowsInserted(); // Empty results count as first result too
+        this->record("full result", m_timer.elapsed());
+        this->finishQuery();
+    }
+}
+
+void Benchmark::handleBenchmark(qint64 time)
+{
+    // Models report the time between a realtime update and the updated model
+    if (m_waitingForUpdates) {
+        this->record("update to model", time);
+    }
+}
+
+void Benchmark::handleTimeout()
+{
+    if (m_draining) {
+        this->fail("Model still busy after the updates of: " + m_job.name);
+        return;
+    }
+    qWarning() << "Query timed out:" << m_job.name;
+    this->record("timeouts", m_timeout->interval());
+    this->finishQuery();
+}
+
+void Benchmark::finishQuery()
+{
+    m_running = false;
+    m_timeout->stop();
+
+    // Keep watching the result for realtime updates if requested
+    if (m_updatesWait > 0 && m_job.kind != StationQuery) {
+        m_waitingForUpdates = true;
+        m_updatesWindow->start(m_updatesWait * 1000);
+        return;
+    }
+    QTimer::singleShot(0, this, SLOT(runNext()));
+}
+
+void Benchmark::handleUpdatesFinished()
+{
+    m_waitingForUpdates = false;
+
+    // Let an update which is being processed finish first, within the query timeout
+    if (this->isBusy()) {
+        m_draining = true;
+        m_timeout->start();
+        return;
+    }
+    this->runNext();
+}
+
+void Benchmark::record(const QString &metric, const qint64 &latency)
+{
+    m_samples[m_job.name + " | " + metric].append(latency);
+}
+
+qint64 Benchmark::percentile(QList<qint64> samples, const qreal &p)
+{
+    // Nearest-rank percentile
+    std::sort(samples.begin(), samples.end());
+    const qint32 rank = qMax(1, qCeil(p / 100.0 * samples.length()));
+    return samples.at(qMin(rank, samples.length()) - 1);
+}
+
+void Benchmark::report()
+{
+    QTextStream out(stdout);
+    out << "realtime transport: " << Realtime::getInstance()->selection() << "\n";
+    out << QString("%1 %2 %3 %4 %5\n")
+           .arg("query | metric", -60).arg("n", 6).arg("p50", 8).arg("p95", 8).arg("p99", 8);
+    QMap<QString, QList<qint64> >::const_iterator it;
+    for (it = m_samples.constBegin(); it != m_samples.constEnd(); ++it) {
+        out << QString("%1 %2 %3 %4 %5\n")
+               .arg(it.key(), -60)
+               .arg(it.value().length(), 6)
+               .arg(Benchmark::percentile(it.value(), 50), 8)
+               .arg(Benchmark::percentile(it.value(), 95), 8)
+               .arg(Benchmark::percentile(it.value(), 99), 8);
+    }
+    out.flush();
+}
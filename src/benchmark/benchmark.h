@@ -0,0 +1,100 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QtCore/QObject>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QDateTime>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QQueue>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+#include <QtCore/QTimer>
+#include <QtCore/QUrl>
+#include <QtCore/QtMath>
+#include <algorithm>
+
+#include "../models/liveboard.h"
+#include "../models/router.h"
+#include "../models/stations.h"
+#include "../network/realtime.h"
+
+// Drives the models with scripted queries and reports latency percentiles
+class Benchmark : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Benchmark(QObject *parent = nullptr);
+    bool parseArguments(const QStringList &arguments);
+    bool hasFailed() const;
+
+public slots:
+    void run();
+
+signals:
+    void done();
+
+private slots:
+    void runNext();
+    void handleRowsInserted();
+    void handleBusyChanged();
+    void handleBenchmark(qint64 time);
+    void handleTimeout();
+    void handleUpdatesFinished();
+
+private:
+    enum Kind {
+        LiveboardQuery,
+        RouterQuery,
+        StationQuery
+    };
+    struct Job {
+        Kind kind;
+        QString name;
+        QStringList arguments;
+    };
+    QQueue<Job> m_jobs;
+    Job m_job;
+    bool m_running;
+    bool m_firstResult;
+    bool m_waitingForUpdates;
+    bool m_draining;
+    bool m_failed;
+    QElapsedTimer m_timer;
+    QTimer *m_timeout;
+    QTimer *m_updatesWindow;
+    QDateTime m_departureTime;
+    quint16 m_maxTransfers;
+    qint32 m_updatesWait;
+    QMap<QString, QList<qint64> > m_samples; // "<job> <metric>" -> latencies in ms
+    Liveboard *m_liveboard;
+    Router *m_router;
+    Stations *m_stations;
+    bool isBusy() const;
+    void reset();
+    void fail(const QString &reason);
+    void record(const QString &metric, const qint64 &latency);
+    void finishQuery();
+    void report();
+    static qint64 percentile(QList<qint64> samples, const qreal &p);
+};
+
+#endif // BENCHMARK_H
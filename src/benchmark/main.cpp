@@ -0,0 +1,45 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <QtCore/QCoreApplication>
+#include <QtCore/QTimer>
+
+#include "qrail.h"
+#include "benchmark.h"
+#include "../network/network.h"
+#include "../tracing/tracer.h"
+#include "../metrics/metrics.h"
+
+// Headless benchmark, build with: qmake CONFIG+=benchmark
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("lcrail-benchmark");
+    initQRail();
+    initNetwork(false); // Every run fetches the same pages, LCRAIL_PAGE_CACHE=on measures the cache
+    Tracer::getInstance(); // Writes the trace on quit when LCRAIL_TRACE is set
+    Metrics::getInstance(); // Dumps the metrics when LCRAIL_METRICS is set
+
+    Benchmark benchmark;
+    if (!benchmark.parseArguments(app.arguments())) {
+        return 1;
+    }
+    QObject::connect(&benchmark, SIGNAL(done()), &app, SLOT(quit()));
+    QTimer::singleShot(0, &benchmark, SLOT(run()));
+
+    const int status = app.exec();
+    return benchmark.hasFailed() ? 1 : status;
+}
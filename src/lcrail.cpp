@@ -3,7 +3,9 @@
 #endif
 
 #include <sailfishapp.h>
+#include <QGuiApplication>
 #include <QQmlEngine>
+#include <QQuickView>
 #include <QUrl>
 #include <QtQml>
 
@@ -11,10 +13,18 @@
 #include "models/liveboard.h"
 #include "models/stations.h"
 #include "models/router.h"
+#include "network/network.h"
+#include "network/prefetcher.h"
+#include "tracing/tracer.h"
+#include "tracing/frametracer.h"
+#include "metrics/metrics.h"
 
 int main(int argc, char *argv[])
 {
+    // The application must exist before anything uses D-Bus, timers or the network
+    QGuiApplication *app = SailfishApp::application(argc, argv);
     initQRail();
+    initNetwork();
     // SailfishApp::main() will display "qml/LCRail.qml", if you need more
     // control over initialization, you can use:
     //
@@ -33,6 +43,16 @@ int main(int argc, char *argv[])
     qmlRegisterType<Liveboard>("LCRail.Views.Liveboard", 1, 0, "Liveboard");
     qmlRegisterType<Router>("LCRail.Views.Router", 1, 0, "Router");
     qmlRegisterType<Stations>("LCRail.Views.Stations", 1, 0, "StationsSearch");
+    qmlRegisterType<Prefetcher>("LCRail.Network", 1, 0, "Prefetcher");
 
-    return SailfishApp::main(argc, argv);
+    // The view is created manually so its frames can be traced
+    QQuickView *view = SailfishApp::createView();
+    Metrics::getInstance(); // Publishes the metrics on D-Bus
+    if (Tracer::getInstance()->isEnabled()) {
+        new FrameTracer(view);
+    }
+    view->setSource(SailfishApp::pathToMainQml());
+    view->show();
+
+    return app->exec();
 }
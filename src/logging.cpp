@@ -0,0 +1,23 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "logging.h"
+
+Q_LOGGING_CATEGORY(lcLiveboard, "lcrail.liveboard", LCRAIL_LOG_DEFAULT)
+Q_LOGGING_CATEGORY(lcRouter, "lcrail.router", LCRAIL_LOG_DEFAULT)
+Q_LOGGING_CATEGORY(lcStations, "lcrail.stations", LCRAIL_LOG_DEFAULT)
+Q_LOGGING_CATEGORY(lcNetwork, "lcrail.network", LCRAIL_LOG_DEFAULT)
+Q_LOGGING_CATEGORY(lcNotifications, "lcrail.notifications", LCRAIL_LOG_DEFAULT)
@@ -0,0 +1,71 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <QtCore/QLoggingCategory>
+#include <QtCore/QDebug>
+
+// Compile-time minimum log level of the models: 0 debug, 1 info, 2 warning, 3 critical.
+// Release builds keep info messages for field diagnostics, override with qmake DEFINES+=LCRAIL_LOG_LEVEL=<level>
+#ifndef LCRAIL_LOG_LEVEL
+#ifdef QT_NO_DEBUG
+#define LCRAIL_LOG_LEVEL 1
+#else
+#define LCRAIL_LOG_LEVEL 0
+#endif
+#endif
+
+// Runtime level of the categories when no logging rules are given, for example:
+// QT_LOGGING_RULES="lcrail.router.info=true" harbour-lcrail
+#ifdef QT_NO_DEBUG
+#define LCRAIL_LOG_DEFAULT QtWarningMsg
+#else
+#define LCRAIL_LOG_DEFAULT QtDebugMsg
+#endif
+
+Q_DECLARE_LOGGING_CATEGORY(lcLiveboard)
+Q_DECLARE_LOGGING_CATEGORY(lcRouter)
+Q_DECLARE_LOGGING_CATEGORY(lcStations)
+Q_DECLARE_LOGGING_CATEGORY(lcNetwork)
+Q_DECLARE_LOGGING_CATEGORY(lcNotifications)
+
+// Levels below LCRAIL_LOG_LEVEL compile to nothing: the streamed arguments are never evaluated.
+// Enabled levels are checked against the category before any argument is evaluated.
+#define LCRAIL_NO_LOG while (false) QMessageLogger().noDebug()
+
+#if LCRAIL_LOG_LEVEL <= 0
+#define lcDebug(category) qCDebug(category)
+#else
+#define lcDebug(category) LCRAIL_NO_LOG
+#endif
+
+#if LCRAIL_LOG_LEVEL <= 1
+#define lcInfo(category) qCInfo(category)
+#else
+#define lcInfo(category) LCRAIL_NO_LOG
+#endif
+
+#if LCRAIL_LOG_LEVEL <= 2
+#define lcWarning(category) qCWarning(category)
+#else
+#define lcWarning(category) LCRAIL_NO_LOG
+#endif
+
+#define lcCritical(category) qCCritical(category)
+
+#endif // LOGGING_H
@@ -0,0 +1,251 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "metrics.h"
+
+Metrics *Metrics::m_instance = nullptr;
+
+Counter::Counter()
+{
+    m_value.store(0);
+}
+
+void Counter::add(const qint64 &value)
+{
+    m_value.fetchAndAddRelaxed(value);
+}
+
+qint64 Counter::value() const
+{
+    return m_value.load();
+}
+
+void Counter::reset()
+{
+    m_value.store(0);
+}
+
+Gauge::Gauge()
+{
+    m_value.store(0);
+}
+
+void Gauge::set(const qint64 &value)
+{
+    m_value.store(value);
+}
+
+qint64 Gauge::value() const
+{
+    return m_value.load();
+}
+
+Histogram::Histogram()
+{
+    this->reset();
+}
+
+qint32 Histogram::bucketOf(const qint64 &value)
+{
+    // Values below 2 * HISTOGRAM_SUB_BUCKETS are exact, above that the lowest bits are dropped
+    quint64 v = qMax(qint64(0), value);
+    qint32 shift = 0;
+    while (v >= 2 * HISTOGRAM_SUB_BUCKETS) {
+        v >>= 1;
+        shift++;
+    }
+    return shift * HISTOGRAM_SUB_BUCKETS + qint32(v);
+}
+
+qint64 Histogram::valueOf(const qint32 &bucket)
+{
+    // Middle of the values which end up in this bucket
+    if (bucket < 2 * HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    const qint32 shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    const qint64 lowest = qint64(bucket % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS) << shift;
+    return lowest + ((qint64(1) << shift) - 1) / 2;
+}
+
+void Histogram::record(const qint64 &value)
+{
+    m_buckets[Histogram::bucketOf(value)].fetchAndAddRelaxed(1);
+    m_count.fetchAndAddRelaxed(1);
+    m_sum.fetchAndAddRelaxed(value);
+    qint64 max = m_max.load();
+    while (value > max && !m_max.testAndSetRelaxed(max, value)) {
+        max = m_max.load();
+    }
+}
+
+qint64 Histogram::count() const
+{
+    return m_count.load();
+}
+
+qint64 Histogram::percentile(const qreal &p) const
+{
+    // Nearest rank, same definition as the benchmark report
+    const qint64 count = this->count();
+    if (count == 0) {
+        return 0;
+    }
+    const qint64 rank = qMax(qint64(1), qint64(p / 100.0 * count + 0.999999));
+    qint64 seen = 0;
+    for (qint32 i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += m_buckets[i].load();
+        if (seen >= rank) {
+            return qMin(Histogram::valueOf(i), m_max.load());
+        }
+    }
+    return m_max.load();
+}
+
+QJsonObject Histogram::toJson() const
+{
+    QJsonObject histogram;
+    const qint64 count = this->count();
+    histogram["count"] = count;
+    histogram["mean"] = count > 0 ? qreal(m_sum.load()) / count : 0.0;
+    histogram["max"] = m_max.load();
+    histogram["p50"] = this->percentile(50);
+    histogram["p95"] = this->percentile(95);
+    histogram["p99"] = this->percentile(99);
+    return histogram;
+}
+
+void Histogram::reset()
+{
+    for (qint32 i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        m_buckets[i].store(0);
+    }
+    m_count.store(0);
+    m_sum.store(0);
+    m_max.store(0);
+}
+
+Metrics::Metrics(QObject *parent) : QObject(parent)
+{
+    // Published on the session bus, next to the notifications
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (!bus.registerObject(METRICS_DBUS_PATH, this, QDBusConnection::ExportScriptableSlots)
+            || !bus.registerService(METRICS_DBUS_SERVICE)) {
+        qWarning() << "Unable to publish metrics on D-Bus:" << bus.lastError().message();
+    }
+
+    // Optional periodic dump, one JSON object per line
+    m_dumpTimer = new QTimer(this);
+    connect(m_dumpTimer, SIGNAL(timeout()), this, SLOT(dump()));
+    m_dumpPath = QString::fromLocal8Bit(qgetenv(LCRAIL_METRICS_VARIABLE));
+    if (!m_dumpPath.isEmpty()) {
+        bool ok = false;
+        qint32 interval = qgetenv(LCRAIL_METRICS_INTERVAL_VARIABLE).toInt(&ok);
+        if (!ok || interval <= 0) {
+            interval = METRICS_DEFAULT_INTERVAL;
+        }
+        m_dumpTimer->start(interval * 1000);
+        if (QCoreApplication::instance()) {
+            connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(dump()));
+        }
+    }
+}
+
+Metrics *Metrics::getInstance()
+{
+    if (m_instance == nullptr) {
+        qDebug() << "Creating new Metrics";
+        m_instance = new Metrics();
+    }
+    return m_instance;
+}
+
+Counter *Metrics::counter(const QString &name)
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_counters.contains(name)) {
+        m_counters.insert(name, new Counter());
+    }
+    return m_counters.value(name);
+}
+
+Gauge *Metrics::gauge(const QString &name)
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_gauges.contains(name)) {
+        m_gauges.insert(name, new Gauge());
+    }
+    return m_gauges.value(name);
+}
+
+Histogram *Metrics::histogram(const QString &name)
+{
+    QMutexLocker locker(&m_lock);
+    if (!m_histograms.contains(name)) {
+        m_histograms.insert(name, new Histogram());
+    }
+    return m_histograms.value(name);
+}
+
+QString Metrics::snapshot()
+{
+    QMutexLocker locker(&m_lock);
+    QJsonObject counters;
+    QJsonObject gauges;
+    QJsonObject histograms;
+    QMap<QString, Counter *>::const_iterator counter;
+    for (counter = m_counters.constBegin(); counter != m_counters.constEnd(); ++counter) {
+        counters[counter.key()] = counter.value()->value();
+    }
+    QMap<QString, Gauge *>::const_iterator gauge;
+    for (gauge = m_gauges.constBegin(); gauge != m_gauges.constEnd(); ++gauge) {
+        gauges[gauge.key()] = gauge.value()->value();
+    }
+    QMap<QString, Histogram *>::const_iterator histogram;
+    for (histogram = m_histograms.constBegin(); histogram != m_histograms.constEnd(); ++histogram) {
+        histograms[histogram.key()] = histogram.value()->toJson();
+    }
+
+    QJsonObject snapshot;
+    snapshot["timestamp"] = QDateTime::currentMSecsSinceEpoch();
+    snapshot["counters"] = counters;
+    snapshot["gauges"] = gauges;
+    snapshot["histograms"] = histograms;
+    return QString::fromUtf8(QJsonDocument(snapshot).toJson(QJsonDocument::Compact));
+}
+
+void Metrics::reset()
+{
+    // Gauges reflect the current state and are kept
+    QMutexLocker locker(&m_lock);
+    foreach (Counter *counter, m_counters) {
+        counter->reset();
+    }
+    foreach (Histogram *histogram, m_histograms) {
+        histogram->reset();
+    }
+}
+
+void Metrics::dump()
+{
+    QFile file(m_dumpPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qCritical() << "Unable to dump metrics:" << m_dumpPath << file.errorString();
+        m_dumpTimer->stop();
+        return;
+    }
+    file.write(this->snapshot().toUtf8() + "\n");
+}
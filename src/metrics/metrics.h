@@ -0,0 +1,119 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QtCore/QObject>
+#include <QtCore/QAtomicInteger>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+#include <QtCore/QDebug>
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusError>
+#include <QtCore/QCoreApplication>
+
+// Environment variables to dump the metrics periodically as JSON lines
+#define LCRAIL_METRICS_VARIABLE "LCRAIL_METRICS"
+#define LCRAIL_METRICS_INTERVAL_VARIABLE "LCRAIL_METRICS_INTERVAL"
+#define METRICS_DEFAULT_INTERVAL 10 // seconds
+#define METRICS_DBUS_SERVICE "harbour.lcrail"
+#define METRICS_DBUS_PATH "/metrics"
+
+// HDR-style histogram: every power of two is split in 16 linear buckets (< 6.25 % error)
+#define HISTOGRAM_SUB_BUCKETS 16
+#define HISTOGRAM_BUCKETS (64 * HISTOGRAM_SUB_BUCKETS)
+
+class Counter
+{
+public:
+    Counter();
+    void add(const qint64 &value = 1);
+    qint64 value() const;
+    void reset();
+
+private:
+    QAtomicInteger<qint64> m_value;
+};
+
+class Gauge
+{
+public:
+    Gauge();
+    void set(const qint64 &value);
+    qint64 value() const;
+
+private:
+    QAtomicInteger<qint64> m_value;
+};
+
+class Histogram
+{
+public:
+    Histogram();
+    void record(const qint64 &value);
+    qint64 count() const;
+    qint64 percentile(const qreal &p) const;
+    QJsonObject toJson() const;
+    void reset();
+
+private:
+    QAtomicInteger<qint64> m_buckets[HISTOGRAM_BUCKETS];
+    QAtomicInteger<qint64> m_count;
+    QAtomicInteger<qint64> m_sum;
+    QAtomicInteger<qint64> m_max;
+    static qint32 bucketOf(const qint64 &value);
+    static qint64 valueOf(const qint32 &bucket);
+};
+
+// Process wide metrics, available on D-Bus as harbour.lcrail /metrics.
+// Look a metric up once and keep the pointer, updating it is lock free.
+class Metrics : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "harbour.lcrail.Metrics")
+public:
+    static Metrics *getInstance();
+    Counter *counter(const QString &name);
+    Gauge *gauge(const QString &name);
+    Histogram *histogram(const QString &name);
+
+public slots:
+    Q_SCRIPTABLE QString snapshot();
+    Q_SCRIPTABLE void reset();
+
+private slots:
+    void dump();
+
+private:
+    explicit Metrics(QObject *parent = nullptr);
+    static Metrics *m_instance;
+    QMutex m_lock;
+    QMap<QString, Counter *> m_counters;
+    QMap<QString, Gauge *> m_gauges;
+    QMap<QString, Histogram *> m_histograms;
+    QTimer *m_dumpTimer;
+    QString m_dumpPath;
+};
+
+#endif // METRICS_H
@@ -16,38 +16,109 @@
 */
 #include "liveboard.h"
 
-Liveboard::Liveboard(QObject *parent): QAbstractListModel(parent)
+QSet<qint32> Liveboard::m_rowsIDs;
+
+// Sort order of the liveboard: by scheduled departure time at the station
+static bool departsBefore(const LiveboardEntry &a, const LiveboardEntry &b)
+{
+    return a.departureTime < b.departureTime;
+}
+
+static LiveboardEntry createEntry(QRail::VehicleEngine::Vehicle *vehicle)
+{
+    QRail::VehicleEngine::Stop *stop = vehicle->intermediaryStops().first();
+    LiveboardEntry entry;
+    entry.vehicle = vehicle;
+    entry.uri = vehicle->uri().toString();
+    entry.tripURI = vehicle->tripURI();
+    entry.headsign = vehicle->headsign();
+    entry.arrivalTime = stop->arrivalTime();
+    entry.departureTime = stop->departureTime();
+    entry.arrivalTimeText = stop->arrivalTime().toLocalTime().toString("hh:mm");
+    entry.departureTimeText = stop->departureTime().toLocalTime().toString("hh:mm");
+    entry.platform = stop->platform();
+    entry.arrivalDelay = stop->arrivalDelay();
+    entry.departureDelay = stop->departureDelay();
+    entry.type = stop->type();
+    entry.occupancyLevel = stop->occupancyLevel();
+    entry.isArrivalCanceled = stop->isArrivalCanceled();
+    entry.isDepartureCanceled = stop->isDepartureCanceled();
+    entry.isPlatformNormal = stop->isPlatformNormal();
+    entry.hasLeft = stop->hasLeft();
+    entry.isExtraStop = stop->isExtraStop();
+    return entry;
+}
+
+Liveboard::Liveboard(QObject *parent): QAbstractListModel(parent), m_query("liveboard", "Liveboard query")
 {
     // Register custom types to the Qt meta object system
     qRegisterMetaType<QRail::VehicleEngine::Stop::Type>("QRail::VehicleEngine::Stop::Type");
     qRegisterMetaType<QRail::VehicleEngine::Stop::OccupancyLevel>("QRail::VehicleEngine::Stop::OccupancyLevel");
 
-    // Retrieve the QRail::LiveboardEngine::Factory instance and connect it's signals
-    m_factory = QRail::LiveboardEngine::Factory::getInstance();
-    connect(m_factory,
+    // Every liveboard has its own session on the QRail::LiveboardEngine::Factory
+    m_session = new LiveboardSession(this);
+    connect(m_session,
             SIGNAL(stream(QRail::VehicleEngine::Vehicle *)),
             this,
             SLOT(handleStream(QRail::VehicleEngine::Vehicle *)));
-    connect(m_factory,
+    connect(m_session,
             SIGNAL(finished(QRail::LiveboardEngine::Board *)),
             this,
             SLOT(handleFinished(QRail::LiveboardEngine::Board *)));
-    connect(m_factory,
+    connect(m_session,
             SIGNAL(processing(QUrl)),
             this,
             SLOT(handleProcessing(QUrl)));
-    connect(m_factory,
+    connect(m_session,
             SIGNAL(error(QString)),
             this,
-            SIGNAL(error(QString)));
-    connect(m_factory, SIGNAL(updateReceived(qint64)), this, SLOT(updateReceived(qint64)));
+            SLOT(handleError(QString)));
+    connect(m_session, SIGNAL(updateReceived(qint64)), this, SLOT(updateReceived(qint64)));
+
+    // Pages are fetched ahead of the factory into the page cache
+    m_prefetcher = new Prefetcher(this);
+
+    // Streamed vehicles are collected during an event loop iteration and inserted at once
+    m_insertTimer = new QTimer(this);
+    m_insertTimer->setSingleShot(true);
+    m_insertTimer->setInterval(0);
+    connect(m_insertTimer, SIGNAL(timeout()), this, SLOT(insertPendingEntries()));
+
+    // Metrics are shared by all liveboards, except the rows of each liveboard
+    Metrics *metrics = Metrics::getInstance();
+    m_rowsID = 0;
+    while (m_rowsIDs.contains(m_rowsID)) {
+        m_rowsID++;
+    }
+    m_rowsIDs.insert(m_rowsID);
+    m_pagesFetched = metrics->counter("pages_fetched");
+    m_rows = metrics->gauge(QString("liveboard_rows_%1").arg(m_rowsID));
+    m_queryLatency = metrics->histogram("liveboard_query_ms");
+    m_updateLatency = metrics->histogram("update_to_display_ms");
 
     // Init variables
-    m_entries = QList<QRail::VehicleEngine::Vehicle *>();
+    m_entries = QVector<LiveboardEntry>();
+    m_pendingEntries = QList<QRail::VehicleEngine::Vehicle *>();
+    m_pendingIndex = QHash<QString, qint32>();
+    m_rowIndex = QHash<QString, qint32>();
     m_liveboard = nullptr;
     m_busy = false;
     m_valid = false;
     m_creating = false;
+    m_isUpdate = false;
+    m_delayedCount = 0;
+    m_canceledCount = 0;
+    m_delays = QMap<qint32, qint32>();
+    m_notifiedDelayedCount = 0;
+    m_notifiedCanceledCount = 0;
+    m_notifiedMaxDelay = 0;
+}
+
+Liveboard::~Liveboard()
+{
+    // The gauge stays registered, a new liveboard takes it over
+    m_rows->set(0);
+    m_rowsIDs.remove(m_rowsID);
 }
 
 // Invokers
@@ -55,33 +126,78 @@ void Liveboard::getBoard(QRail::StationEngine::Station *station,
                          const QRail::LiveboardEngine::Board::Mode &mode)
 {
     this->setBusy(true);
-    m_before = QDateTime::currentMSecsSinceEpoch();
-    m_factory->getLiveboardByStationURI(station->uri(), mode);
+    m_prefetcher->cancel(); // Window unknown, the factory fetches the pages itself
+    m_query.start();
+    m_isUpdate = false;
+    m_session->getLiveboardByStationURI(station->uri(), mode);
 }
 
 void Liveboard::getBoard(const QUrl &uri, const QRail::LiveboardEngine::Board::Mode &mode)
 {
     this->setBusy(true);
-    m_before = QDateTime::currentMSecsSinceEpoch();
-    m_factory->getLiveboardByStationURI(uri, QDateTime::currentDateTimeUtc(), QDateTime::currentDateTimeUtc().addSecs(6*1800), mode);
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const qint64 window = StationDensity::getInstance()->window(uri, LIVEBOARD_WINDOW);
+    m_prefetcher->prefetch(now, now.addSecs(window));
+    m_query.start();
+    m_isUpdate = false;
+    m_session->getLiveboardByStationURI(uri, now, now.addSecs(window), mode);
 }
 
 void Liveboard::getBoard(const QUrl &uri, const QDateTime departureTime, const QRail::LiveboardEngine::Board::Mode &mode)
 {
     this->setBusy(true);
-    m_before = QDateTime::currentMSecsSinceEpoch();
-    qDebug() << departureTime;
-    m_factory->getLiveboardByStationURI(uri, departureTime.toUTC(), departureTime.toUTC().addSecs(3 * 3600), mode);
+    this->prefetch(departureTime, uri); // Keeps fetching ahead of the factory
+    m_query.start();
+    m_isUpdate = false;
+    const qint64 window = StationDensity::getInstance()->window(uri, LIVEBOARD_WINDOW);
+    lcDebug(lcLiveboard) << "Departure time:" << departureTime << "window:" << window << "s";
+    m_session->getLiveboardByStationURI(uri, departureTime.toUTC(), departureTime.toUTC().addSecs(window), mode);
+}
+
+void Liveboard::prefetch(const QDateTime &departureTime, const QUrl &uri)
+{
+    // Same window as getBoard()
+    const qint64 window = StationDensity::getInstance()->window(uri, LIVEBOARD_WINDOW);
+    m_prefetcher->prefetch(departureTime, departureTime.addSecs(window));
+}
+
+void Liveboard::prefetchNext()
+{
+    // Quietly warms the pages loadNext() will need, never takes over a running prefetch
+    if (!m_liveboard || this->isBusy() || m_prefetcher->isRunning() || m_prefetchedUntil == this->until()) {
+        return;
+    }
+    m_prefetchedUntil = this->until();
+    const qint64 window = StationDensity::getInstance()->window(m_liveboard->station()->uri(), LIVEBOARD_WINDOW);
+    m_prefetcher->prefetch(m_prefetchedUntil, m_prefetchedUntil.addSecs(window));
+}
+
+void Liveboard::prefetchPrevious()
+{
+    // Quietly warms the pages loadPrevious() will need
+    if (!m_liveboard || this->isBusy() || m_prefetcher->isRunning() || m_prefetchedFrom == this->from()) {
+        return;
+    }
+    m_prefetchedFrom = this->from();
+    const qint64 window = StationDensity::getInstance()->window(m_liveboard->station()->uri(), LIVEBOARD_WINDOW);
+    m_prefetcher->prefetch(m_prefetchedFrom.addSecs(-window), m_prefetchedFrom);
 }
 
 void Liveboard::clearBoard()
 {
     this->beginResetModel();
+    m_insertTimer->stop();
+    m_pendingEntries.clear();
+    m_pendingIndex.clear();
     m_entries.clear();
+    m_rowIndex.clear();
     m_liveboard = nullptr;
+    m_session->unwatch(); // Board of the cleared entries
     m_creating = true;
+    this->resetAggregates();
     this->setValid(false);
     this->endResetModel();
+    this->publishAggregates();
 }
 
 // Helpers
@@ -104,34 +220,38 @@ QHash<int, QByteArray> Liveboard::roleNames() const
     roles[occupancyLevelRole] = "occupancy";
     roles[isExtraStopRole] = "isExtraStop";
     roles[hasDelay] = "hasDelay";
+    roles[arrivalTimeTextRole] = "arrivalTimeText";
+    roles[departureTimeTextRole] = "departureTimeText";
     return roles;
 }
 
 void Liveboard::loadNext()
 {
     if (m_liveboard && !this->isBusy()) {
-        qDebug() << "Extending liveboard NEXT";
+        lcInfo(lcLiveboard) << "Extending liveboard NEXT";
         this->setBusy(true);
-        m_factory->getNextResultsForLiveboard(this->m_liveboard);
+        m_session->getNextResultsForLiveboard(this->m_liveboard);
     }
 }
 
 void Liveboard::loadPrevious()
 {
     if (m_liveboard && !this->isBusy()) {
-        qDebug() << "Extending liveboard PREVIOUS";
+        lcInfo(lcLiveboard) << "Extending liveboard PREVIOUS";
         this->setBusy(true);
-        m_factory->getPreviousResultsForLiveboard(this->m_liveboard);
+        m_session->getPreviousResultsForLiveboard(this->m_liveboard);
     }
 }
 
 void Liveboard::abortCurrentOperation()
 {
     if(this->isBusy()) {
-        qDebug() << "Abort Liveboard";
-        m_factory->abortCurrentOperation();
-        m_factory->unwatchAll();
+        lcInfo(lcLiveboard) << "Abort Liveboard";
+        m_prefetcher->cancel();
+        m_session->cancel();
+        m_session->unwatch();
         this->setValid(false);
+        this->setBusy(false);
     }
 }
 
@@ -146,49 +266,44 @@ QVariant Liveboard::data(const QModelIndex &index, int role) const
         return QVariant();
     }
     // Break not needed since return makes the rest unreachable.
+    const LiveboardEntry &entry = m_entries.at(index.row());
     switch (role) {
     case URIRole:
-        return QVariant(m_entries.at(index.row())->uri().toString());
+        return QVariant(entry.uri);
     case tripURIRole:
-        return QVariant(m_entries.at(index.row())->tripURI());
+        return QVariant(entry.tripURI);
     case headsignRole:
-        return QVariant(m_entries.at(index.row())->headsign());
+        return QVariant(entry.headsign);
     case arrivalTimeRole:
-        return QVariant(m_entries.at(index.row())->intermediaryStops().first()->arrivalTime());
+        return QVariant(entry.arrivalTime);
+    case arrivalTimeTextRole:
+        return QVariant(entry.arrivalTimeText);
     case arrivalDelayRole:
-        return QVariant(m_entries.at(index.row())->intermediaryStops().first()->arrivalDelay());
+        return QVariant(entry.arrivalDelay);
     case isArrivalCanceledRole:
-        return QVariant(m_entries.at(
-                            index.row())->intermediaryStops().first()->isArrivalCanceled());
+        return QVariant(entry.isArrivalCanceled);
     case departureTimeRole:
-        return QVariant(m_entries.at(index.row())->intermediaryStops().first()->departureTime());
+        return QVariant(entry.departureTime);
+    case departureTimeTextRole:
+        return QVariant(entry.departureTimeText);
     case departureDelayRole:
-        return QVariant(m_entries.at(index.row())->intermediaryStops().first()->departureDelay());
+        return QVariant(entry.departureDelay);
     case isDepartureCanceledRole:
-        return QVariant(m_entries.at(
-                            index.row())->intermediaryStops().first()->isDepartureCanceled());
+        return QVariant(entry.isDepartureCanceled);
     case platformRole:
-        return QVariant(m_entries.at(index.row())->intermediaryStops().first()->platform());
+        return QVariant(entry.platform);
     case isPlatformNormalRole:
-        return QVariant(m_entries.at(
-                            index.row())->intermediaryStops().first()->isPlatformNormal());
+        return QVariant(entry.isPlatformNormal);
     case hasLeftRole:
-        return QVariant(m_entries.at(index.row())->intermediaryStops().first()->hasLeft());
+        return QVariant(entry.hasLeft);
     case stopTypeRole:
-        return QVariant::fromValue(m_entries.at(index.row())->intermediaryStops().first()->type());
+        return QVariant::fromValue(entry.type);
     case occupancyLevelRole:
-        return QVariant::fromValue(m_entries.at(
-                                       index.row())->intermediaryStops().first()->occupancyLevel());
+        return QVariant::fromValue(entry.occupancyLevel);
     case isExtraStopRole:
-        return QVariant(m_entries.at(index.row())->intermediaryStops().first()->isExtraStop());
+        return QVariant(entry.isExtraStop);
     case hasDelay:
-        foreach (QRail::VehicleEngine::Vehicle *vehicle, m_entries) {
-            if (vehicle->intermediaryStops().first()->arrivalDelay() > 0
-                    || vehicle->intermediaryStops().first()->departureDelay() > 0) {
-                return true;
-            }
-        }
-        return false;
+        return QVariant(m_delayedCount > 0);
     default:
         return QVariant();
     }
@@ -197,100 +312,411 @@ QVariant Liveboard::data(const QModelIndex &index, int role) const
 // Processors
 void Liveboard::handleStream(QRail::VehicleEngine::Vehicle *entry)
 {
-    qDebug() << "Inserting:" << entry->uri() << "to:" << entry->headsign() << "time=" <<
+    TRACE_SPAN("model", "Liveboard::handleStream");
+    lcDebug(lcLiveboard) << "Inserting:" << entry->uri() << "to:" << entry->headsign() << "time=" <<
              entry->intermediaryStops().first()->departureTime()
              << "+" << entry->intermediaryStops().first()->departureDelay();
     this->setBusy(true);
 
-    QDateTime newEntryDepartureTime = entry->intermediaryStops().first()->departureTime();
-    if(m_creating) {
-        for (qint16 i = 0; i < m_entries.length(); i++) {
-            QDateTime entryDepartureTime = m_entries.at(i)->intermediaryStops().first()->departureTime();
-            // TO DO: Smarter inserting: Departure and arrival time are now the same, so this works for now
-            if (entryDepartureTime > newEntryDepartureTime) {
-                this->beginInsertRows(QModelIndex(), i, i);
-                m_entries.insert(i, entry);
-                this->endInsertRows();
-                return;
+    if(!m_creating) {
+        // Update existing entries (updates) in place
+        const qint32 row = this->rowOf(entry->uri().toString());
+        if (row >= 0) {
+            const qint32 delay = m_entries.at(row).departureDelay;
+            this->updateEntry(row, createEntry(entry));
+            if (delay != entry->intermediaryStops().first()->departureDelay()) {
+                // Notify user
+                NotificationScheduler::getInstance()->schedule(entry->uri().toString(),
+                                                               "Liveboard updated!",
+                                                               "Vehicle to " + entry->headsign()
+                                                               + " (" + entry->intermediaryStops().first()->departureTime().toLocalTime().toString("hh:mm") + ") has been updated.",
+                                                               "social",
+                                                               "lcrail-liveboard-update");
             }
+            return;
         }
     }
-    else {
-        for (qint16 i = 0; i < m_entries.length(); i++) {
-            // Update existing entries (updates)
-            if(m_entries.at(i)->uri() == entry->uri()) {
-                if(m_entries.at(i)->intermediaryStops().first()->departureDelay() != entry->intermediaryStops().first()->departureDelay()) {
-                   /* // Remove old entry
-                    this->beginRemoveRows(QModelIndex(), i, i);
-                    m_entries.removeAt(i);
-                    this->endRemoveRows();
-
-                    // Insert new entry
-                    this->beginInsertRows(QModelIndex(), i, i);
-                    m_entries.insert(i, entry);
-                    this->endInsertRows();*/
-
-                    // Notify user
-                    SailfishOS::createNotification("Liveboard updated!",
-                                                   "Vehicle to " + entry->headsign()
-                                                   + " (" + entry->intermediaryStops().first()->departureTime().toLocalTime().toString("hh:mm") + ") has been updated.",
-                                                   "social",
-                                                   "lcrail-liveboard-update");
-                }
-                return;
-            }
-        }
+
+    // New entry, inserted in order together with the rest of this event loop iteration
+    this->queueEntry(entry);
+}
+
+qint32 Liveboard::rowOf(const QString &uri) const
+{
+    return m_rowIndex.value(uri, -1);
+}
+
+void Liveboard::reindex(const qint32 &from, const qint32 &to)
+{
+    // Rows in [from, to) were inserted, moved or shifted
+    for (qint32 row = from; row < to; row++) {
+        m_rowIndex.insert(m_entries.at(row).uri, row);
+    }
+}
+
+void Liveboard::updateEntry(const qint32 &row, const LiveboardEntry &entry)
+{
+    TRACE_SPAN("model", "Liveboard::updateEntry");
+    const LiveboardEntry previous = m_entries.at(row);
+
+    // Only the roles which really changed are announced, delegates rebind just those
+    QVector<int> roles;
+    if (previous.headsign != entry.headsign) {
+        roles << headsignRole;
+    }
+    if (previous.arrivalTime != entry.arrivalTime) {
+        roles << arrivalTimeRole << arrivalTimeTextRole;
+    }
+    if (previous.departureTime != entry.departureTime) {
+        roles << departureTimeRole << departureTimeTextRole;
+    }
+    if (previous.arrivalDelay != entry.arrivalDelay) {
+        roles << arrivalDelayRole;
+    }
+    if (previous.departureDelay != entry.departureDelay) {
+        roles << departureDelayRole;
+    }
+    if (previous.isArrivalCanceled != entry.isArrivalCanceled) {
+        roles << isArrivalCanceledRole;
+    }
+    if (previous.isDepartureCanceled != entry.isDepartureCanceled) {
+        roles << isDepartureCanceledRole;
+    }
+    if (previous.platform != entry.platform) {
+        roles << platformRole;
+    }
+    if (previous.isPlatformNormal != entry.isPlatformNormal) {
+        roles << isPlatformNormalRole;
+    }
+    if (previous.hasLeft != entry.hasLeft) {
+        roles << hasLeftRole;
+    }
+    if (previous.type != entry.type) {
+        roles << stopTypeRole;
+    }
+    if (previous.occupancyLevel != entry.occupancyLevel) {
+        roles << occupancyLevelRole;
+    }
+    if (previous.isExtraStop != entry.isExtraStop) {
+        roles << isExtraStopRole;
+    }
+
+    this->accountEntry(previous, -1);
+    this->accountEntry(entry, 1);
+    m_entries.replace(row, entry);
+
+    // Moved when its departure doesn't fit between its neighbours anymore
+    qint32 destination = row;
+    if (row > 0 && departsBefore(entry, m_entries.at(row - 1))) {
+        destination = std::upper_bound(m_entries.begin(), m_entries.begin() + row, entry, departsBefore) - m_entries.begin();
+        this->beginMoveRows(QModelIndex(), row, row, QModelIndex(), destination);
+        m_entries.move(row, destination);
+        this->reindex(destination, row + 1);
+        this->endMoveRows();
+    }
+    else if (row + 1 < m_entries.length() && departsBefore(m_entries.at(row + 1), entry)) {
+        const qint32 target = std::upper_bound(m_entries.begin() + row + 1, m_entries.end(), entry, departsBefore) - m_entries.begin();
+        destination = target - 1;
+        this->beginMoveRows(QModelIndex(), row, row, QModelIndex(), target);
+        m_entries.move(row, destination);
+        this->reindex(row, destination + 1);
+        this->endMoveRows();
+    }
+
+    if (!roles.isEmpty()) {
+        emit this->dataChanged(this->index(destination), this->index(destination), roles);
+    }
+    this->publishAggregates();
+}
+
+void Liveboard::queueEntry(QRail::VehicleEngine::Vehicle *entry)
+{
+    // A vehicle streamed again before it's inserted is only inserted once, with its latest data
+    const QString uri = entry->uri().toString();
+    const qint32 index = m_pendingIndex.value(uri, -1);
+    if (index >= 0) {
+        m_pendingEntries.replace(index, entry);
+        return;
+    }
+    m_pendingIndex.insert(uri, m_pendingEntries.length());
+    m_pendingEntries.append(entry);
+    if (!m_insertTimer->isActive()) {
+        m_insertTimer->start();
+    }
+}
+
+void Liveboard::insertPendingEntries()
+{
+    TRACE_SPAN("model", "Liveboard::insertPendingEntries");
+    if (m_pendingEntries.isEmpty()) {
+        return;
     }
 
-    // Entry should be added in front or at the end of the list (if not found above)
-    this->beginInsertRows(QModelIndex(), m_entries.length(), m_entries.length());
-    m_entries.append(entry);
-    this->endInsertRows();
+    QVector<LiveboardEntry> pending;
+    pending.reserve(m_pendingEntries.length());
+    foreach (QRail::VehicleEngine::Vehicle *vehicle, m_pendingEntries) {
+        pending.append(createEntry(vehicle));
+    }
+    m_pendingEntries.clear();
+    m_pendingIndex.clear();
+    m_insertTimer->stop();
+    this->insertEntries(pending);
+}
+
+void Liveboard::insertEntries(QVector<LiveboardEntry> pending)
+{
+    // Stable: vehicles with the same departure time keep their streaming order
+    std::stable_sort(pending.begin(), pending.end(), departsBefore);
+
+    // Pending entries are sorted, every binary search can start after the previous insert.
+    // Entries which end up in the same gap of the board are inserted as one row range.
+    qint32 searchFrom = 0;
+    qint32 firstRow = m_entries.length();
+    qint32 i = 0;
+    while (i < pending.length()) {
+        const qint32 row = std::upper_bound(m_entries.begin() + searchFrom, m_entries.end(),
+                                            pending.at(i), departsBefore) - m_entries.begin();
+        qint32 j = i + 1;
+        while (j < pending.length()
+               && (row == m_entries.length() || departsBefore(pending.at(j), m_entries.at(row)))) {
+            j++;
+        }
+
+        this->beginInsertRows(QModelIndex(), row, row + (j - i) - 1);
+        for (qint32 k = i; k < j; k++) {
+            m_entries.insert(row + (k - i), pending.at(k));
+            this->accountEntry(pending.at(k), 1);
+        }
+        firstRow = qMin(firstRow, row);
+        this->endInsertRows();
+
+        searchFrom = row + (j - i);
+        i = j;
+    }
+    this->reindex(firstRow, m_entries.length()); // Rows after the first insert shifted
+    this->publishAggregates();
 }
 
 void Liveboard::handleProcessing(const QUrl &uri)
 {
+    TRACE_INSTANT("network", "Liveboard page", uri.toString());
+    m_pagesFetched->add();
     // Task started or running
     QUrlQuery query = QUrlQuery(uri);
     QDateTime timestamp = QDateTime::fromString(query.queryItemValue("departureTime"), Qt::ISODate);
+    m_prefetcher->consumed(timestamp);
     emit this->processing(uri.toString(), timestamp);
 }
 
 void Liveboard::handleFinished(QRail::LiveboardEngine::Board *board)
 {
-    qDebug() << "Received new Liveboard";
-    this->beginResetModel();
-    m_entries.clear();
-    this->endResetModel();
-    for(qint64 e=0; e < board->entries().length(); e++) {
-        this->beginInsertRows(QModelIndex(), e, e);
-        m_entries.insert(e, board->entries().at(e));
-        this->endInsertRows();
-    }
+    TRACE_SPAN("model", "Liveboard::handleFinished");
+    lcInfo(lcLiveboard) << "Received new Liveboard";
+    m_prefetcher->cancel(); // Pages the factory didn't need anymore
+    this->insertPendingEntries();
+    this->mergeEntries(board->entries());
     m_creating = false;
-    m_factory->unwatchAll();
-    m_factory->watch(board);
+    m_session->watch(board);
     m_liveboard = board;
+    if (!m_isUpdate) {
+        // Sizes the next windows of this station
+        StationDensity::getInstance()->record(board->station()->uri(), board->entries().length(),
+                                              board->from().secsTo(board->until()));
+    }
     emit this->stationChanged();
     emit this->fromChanged();
     emit this->untilChanged();
 
     // A complete liveboard is ready
     this->setValid(true);
-    m_after = QDateTime::currentMSecsSinceEpoch();
-    qDebug() << "AFTER:" << m_after;
-    qDebug() << "BEFORE:" << m_before;
-    emit this->benchmark(m_after - m_before);
+    const qint64 elapsed = m_query.finish();
+    (m_isUpdate ? m_updateLatency : m_queryLatency)->record(elapsed);
+    emit this->benchmark(elapsed);
 
     // Task finished
     this->setBusy(false);
 }
 
+void Liveboard::handleError(const QString &message)
+{
+    lcWarning(lcLiveboard) << "Liveboard failed:" << message;
+    m_prefetcher->cancel();
+    this->insertPendingEntries();
+    m_creating = false;
+    this->setBusy(false);
+    emit this->error(message);
+}
+
+void Liveboard::mergeEntries(const QList<QRail::VehicleEngine::Vehicle *> &vehicles)
+{
+    QVector<LiveboardEntry> entries;
+    entries.reserve(vehicles.length());
+    foreach (QRail::VehicleEngine::Vehicle *vehicle, vehicles) {
+        entries.append(createEntry(vehicle));
+    }
+    this->mergeEntries(entries);
+}
+
+void Liveboard::mergeEntries(const QVector<LiveboardEntry> &entries)
+{
+    TRACE_SPAN("model", "Liveboard::mergeEntries");
+    // Only apply the differences between the board and the streamed entries,
+    // existing delegates and the scroll position are kept this way.
+    QSet<QString> wanted;
+    foreach (const LiveboardEntry &entry, entries) {
+        wanted.insert(entry.uri);
+    }
+
+    // Drop vehicles which aren't part of the board anymore, bottom-up in contiguous ranges
+    qint32 last = m_entries.length() - 1;
+    while (last >= 0) {
+        if (wanted.contains(m_entries.at(last).uri)) {
+            last--;
+            continue;
+        }
+
+        qint32 first = last;
+        while (first > 0 && !wanted.contains(m_entries.at(first - 1).uri)) {
+            first--;
+        }
+
+        this->beginRemoveRows(QModelIndex(), first, last);
+        for (qint32 r = last; r >= first; r--) {
+            this->accountEntry(m_entries.at(r), -1);
+            m_entries.removeAt(r);
+        }
+        this->endRemoveRows();
+        last = first - 1;
+    }
+
+    QSet<QString> current;
+    foreach (const LiveboardEntry &entry, m_entries) {
+        current.insert(entry.uri);
+    }
+
+    // Walk through the board in order, every row is either kept, moved up or inserted
+    for (qint32 row = 0; row < entries.length(); row++) {
+        const LiveboardEntry &entry = entries.at(row);
+
+        if (!current.contains(entry.uri)) {
+            // Insert all consecutive new vehicles at once
+            qint32 count = 1;
+            while (row + count < entries.length() && !current.contains(entries.at(row + count).uri)) {
+                count++;
+            }
+
+            this->beginInsertRows(QModelIndex(), row, row + count - 1);
+            for (qint32 k = 0; k < count; k++) {
+                m_entries.insert(row + k, entries.at(row + k));
+                this->accountEntry(entries.at(row + k), 1);
+            }
+            this->endInsertRows();
+            row += count - 1;
+            continue;
+        }
+
+        if (row >= m_entries.length() || m_entries.at(row).uri != entry.uri) {
+            qint32 from = row + 1;
+            while (from < m_entries.length() && m_entries.at(from).uri != entry.uri) {
+                from++;
+            }
+
+            // Vehicle is listed twice in the board and already used above
+            if (from >= m_entries.length()) {
+                this->beginInsertRows(QModelIndex(), row, row);
+                m_entries.insert(row, entry);
+                this->accountEntry(entry, 1);
+                this->endInsertRows();
+                continue;
+            }
+
+            this->beginMoveRows(QModelIndex(), from, from, QModelIndex(), row);
+            m_entries.insert(row, m_entries.takeAt(from));
+            this->endMoveRows();
+        }
+
+        if (m_entries.at(row).vehicle != entry.vehicle) {
+            this->accountEntry(m_entries.at(row), -1);
+            this->accountEntry(entry, 1);
+            m_entries.replace(row, entry);
+            emit this->dataChanged(this->index(row), this->index(row));
+        }
+    }
+
+    // Duplicated URIs in the board may leave some rows behind
+    if (m_entries.length() > entries.length()) {
+        this->beginRemoveRows(QModelIndex(), entries.length(), m_entries.length() - 1);
+        while (m_entries.length() > entries.length()) {
+            this->accountEntry(m_entries.last(), -1);
+            m_entries.removeLast();
+        }
+        this->endRemoveRows();
+    }
+    m_rowIndex.clear();
+    this->reindex(0, m_entries.length());
+    this->publishAggregates();
+}
+
+void Liveboard::accountEntry(const LiveboardEntry &entry, const qint32 &weight)
+{
+    // Keep the board aggregates up to date, weight is +1 for added and -1 for removed entries
+    const qint32 delay = qMax(entry.arrivalDelay, entry.departureDelay);
+    if (delay > 0) {
+        m_delayedCount += weight;
+        const qint32 count = m_delays.value(delay) + weight;
+        if (count > 0) {
+            m_delays.insert(delay, count);
+        }
+        else {
+            m_delays.remove(delay);
+        }
+    }
+
+    if (entry.isArrivalCanceled || entry.isDepartureCanceled) {
+        m_canceledCount += weight;
+    }
+}
+
+void Liveboard::resetAggregates()
+{
+    m_delayedCount = 0;
+    m_canceledCount = 0;
+    m_delays.clear();
+}
+
+void Liveboard::publishAggregates()
+{
+    m_rows->set(m_entries.length());
+
+    // Only fire the signals when the aggregates really are changed
+    if (m_notifiedDelayedCount != m_delayedCount) {
+        // The hasDelay role is board wide and only changes when the first delay appears or the last one disappears
+        const bool hasDelayChanged = (m_notifiedDelayedCount > 0) != (m_delayedCount > 0);
+        m_notifiedDelayedCount = m_delayedCount;
+        emit this->delayedCountChanged();
+        if (hasDelayChanged && !m_entries.isEmpty()) {
+            emit this->dataChanged(this->index(0), this->index(m_entries.length() - 1),
+                                   QVector<int>() << hasDelay);
+        }
+    }
+
+    if (m_notifiedCanceledCount != m_canceledCount) {
+        m_notifiedCanceledCount = m_canceledCount;
+        emit this->canceledCountChanged();
+    }
+
+    if (m_notifiedMaxDelay != this->maxDelay()) {
+        m_notifiedMaxDelay = this->maxDelay();
+        emit this->maxDelayChanged();
+    }
+}
+
 void Liveboard::updateReceived(qint64 timestamp)
 {
     // Benchmark must measure the time from the update receivement until the change is shown to the user.
     this->setBusy(true); // Triggers benchmark
-    m_before = timestamp;
+    m_query.startAt(timestamp);
+    m_isUpdate = true;
 }
 
 // Getters & Setters
@@ -331,6 +757,21 @@ void Liveboard::setUntil(const QDateTime &until)
     }
 }
 
+qint32 Liveboard::delayedCount() const
+{
+    return m_delayedCount;
+}
+
+qint32 Liveboard::canceledCount() const
+{
+    return m_canceledCount;
+}
+
+qint32 Liveboard::maxDelay() const
+{
+    return m_delays.isEmpty() ? 0 : m_delays.lastKey();
+}
+
 bool Liveboard::isBusy() const
 {
     return m_busy;
@@ -20,12 +20,17 @@
 #include <QtCore/QAbstractListModel>
 #include <QtCore/QDateTime>
 #include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QVector>
 #include <QtCore/QModelIndex>
 #include <QtCore/QUrl>
 #include <QtCore/QUrlQuery>
 #include <QtCore/QHash>
+#include <QtCore/QSet>
 #include <QtCore/QByteArray>
+#include <QtCore/QString>
 #include <QtCore/QVariant>
+#include <QtCore/QTimer>
 #include <algorithm>
 
 #include "engines/liveboard/liveboardboard.h"
@@ -33,6 +38,38 @@
 #include "engines/station/stationstation.h"
 #include "engines/vehicle/vehiclevehicle.h"
 #include "../sailfishos.h"
+#include "../notificationscheduler.h"
+#include "../logging.h"
+#include "../tracing/tracer.h"
+#include "../metrics/metrics.h"
+#include "../network/prefetcher.h"
+#include "../sessions/liveboardsession.h"
+#include "stationdensity.h"
+
+#define LIVEBOARD_WINDOW (3 * 3600) // seconds after the departure time, until the station density is known
+
+// Flat copy of everything a liveboard delegate shows, built once when a vehicle is inserted or updated
+struct LiveboardEntry {
+    QRail::VehicleEngine::Vehicle *vehicle;
+    QString uri;
+    QUrl tripURI;
+    QString headsign;
+    QDateTime arrivalTime;
+    QDateTime departureTime;
+    QString arrivalTimeText;
+    QString departureTimeText;
+    QString platform;
+    qint32 arrivalDelay;
+    qint32 departureDelay;
+    QRail::VehicleEngine::Stop::Type type;
+    QRail::VehicleEngine::Stop::OccupancyLevel occupancyLevel;
+    bool isArrivalCanceled;
+    bool isDepartureCanceled;
+    bool isPlatformNormal;
+    bool hasLeft;
+    bool isExtraStop;
+};
+Q_DECLARE_TYPEINFO(LiveboardEntry, Q_MOVABLE_TYPE);
 
 class Liveboard : public QAbstractListModel
 {
@@ -42,6 +79,9 @@ class Liveboard : public QAbstractListModel
     Q_PROPERTY(QRail::StationEngine::Station *station READ station NOTIFY stationChanged)
     Q_PROPERTY(QDateTime from READ from NOTIFY fromChanged)
     Q_PROPERTY(QDateTime until READ until NOTIFY untilChanged)
+    Q_PROPERTY(qint32 delayedCount READ delayedCount NOTIFY delayedCountChanged)
+    Q_PROPERTY(qint32 canceledCount READ canceledCount NOTIFY canceledCountChanged)
+    Q_PROPERTY(qint32 maxDelay READ maxDelay NOTIFY maxDelayChanged)
 
 public:
     // Entries roles
@@ -61,9 +101,12 @@ public:
         stopTypeRole = Qt::UserRole + 13,
         occupancyLevelRole = Qt::UserRole + 14,
         isExtraStopRole = Qt::UserRole + 15,
-        hasDelay = Qt::UserRole + 16
+        hasDelay = Qt::UserRole + 16,
+        arrivalTimeTextRole = Qt::UserRole + 17,
+        departureTimeTextRole = Qt::UserRole + 18
     };
     explicit Liveboard(QObject *parent = nullptr);
+    ~Liveboard();
     virtual int rowCount(const QModelIndex &) const;
     virtual QVariant data(const QModelIndex &index, int role) const;
     QRail::StationEngine::Station *station();
@@ -71,6 +114,9 @@ public:
     QDateTime until() const;
     bool isBusy() const;
     bool isValid() const;
+    qint32 delayedCount() const;
+    qint32 canceledCount() const;
+    qint32 maxDelay() const;
     Q_INVOKABLE void getBoard(QRail::StationEngine::Station *station,
                               const QRail::LiveboardEngine::Board::Mode &mode = QRail::LiveboardEngine::Board::Mode::DEPARTURES);
     Q_INVOKABLE void getBoard(const QUrl &uri,
@@ -79,6 +125,9 @@ public:
                               const QDateTime departureTime,
                               const QRail::LiveboardEngine::Board::Mode &mode = QRail::LiveboardEngine::Board::Mode::DEPARTURES);
 
+    Q_INVOKABLE void prefetch(const QDateTime &departureTime, const QUrl &uri = QUrl());
+    Q_INVOKABLE void prefetchNext();
+    Q_INVOKABLE void prefetchPrevious();
     Q_INVOKABLE void clearBoard();
     Q_INVOKABLE void loadNext(); // fetchMore is only usuable for synced operations
     Q_INVOKABLE void loadPrevious();
@@ -94,6 +143,9 @@ signals:
     void stationChanged();
     void fromChanged();
     void untilChanged();
+    void delayedCountChanged();
+    void canceledCountChanged();
+    void maxDelayChanged();
     void processing(const QString &uri, const QDateTime &timestamp);
     void error(const QString &message);
     void finished();
@@ -103,23 +155,54 @@ private slots:
     void handleStream(QRail::VehicleEngine::Vehicle *entry);
     void handleProcessing(const QUrl &uri);
     void handleFinished(QRail::LiveboardEngine::Board *board);
+    void handleError(const QString &message);
     void updateReceived(qint64 timestamp);
+    void insertPendingEntries();
 
 private:
-    qint64 m_before;
-    qint64 m_after;
+    friend class TestLiveboard;
+    TraceInterval m_query; // request or realtime update until the model is complete
+    bool m_isUpdate;
+    Counter *m_pagesFetched;
+    Gauge *m_rows; // liveboard_rows_<m_rowsID>
+    qint32 m_rowsID;
+    static QSet<qint32> m_rowsIDs; // in use, IDs of destroyed liveboards are reused
+    Histogram *m_queryLatency;
+    Histogram *m_updateLatency;
     bool m_busy;
     bool m_valid;
     bool m_creating;
     QRail::LiveboardEngine::Board *m_liveboard;
-    QList<QRail::VehicleEngine::Vehicle *> m_entries;
-    bool m_hasDelay;
-    QRail::LiveboardEngine::Factory *m_factory;
+    QVector<LiveboardEntry> m_entries;
+    QList<QRail::VehicleEngine::Vehicle *> m_pendingEntries;
+    QHash<QString, qint32> m_pendingIndex; // URI -> position in m_pendingEntries
+    QHash<QString, qint32> m_rowIndex; // URI -> row
+    QTimer *m_insertTimer;
+    qint32 m_delayedCount;
+    qint32 m_canceledCount;
+    QMap<qint32, qint32> m_delays; // delay -> number of delayed entries
+    qint32 m_notifiedDelayedCount;
+    qint32 m_notifiedCanceledCount;
+    qint32 m_notifiedMaxDelay;
+    LiveboardSession *m_session;
+    Prefetcher *m_prefetcher;
+    QDateTime m_prefetchedFrom;
+    QDateTime m_prefetchedUntil;
     void setBusy(const bool &busy);
     void setValid(const bool &valid);
     void setFrom(const QDateTime &from);
     void setUntil(const QDateTime &until);
     void setStation(QRail::StationEngine::Station *station);
+    void queueEntry(QRail::VehicleEngine::Vehicle *entry);
+    qint32 rowOf(const QString &uri) const;
+    void reindex(const qint32 &from, const qint32 &to);
+    void insertEntries(QVector<LiveboardEntry> pending);
+    void updateEntry(const qint32 &row, const LiveboardEntry &entry);
+    void mergeEntries(const QList<QRail::VehicleEngine::Vehicle *> &vehicles);
+    void mergeEntries(const QVector<LiveboardEntry> &entries);
+    void accountEntry(const LiveboardEntry &entry, const qint32 &weight);
+    void resetAggregates();
+    void publishAggregates();
 };
 
 #endif // LIVEBOARD_H
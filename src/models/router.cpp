@@ -16,7 +16,44 @@
 */
 #include "router.h"
 
-Router::Router(QObject *parent) : QAbstractListModel(parent)
+// Sort order of the routes: by departure time
+static bool departsBefore(const RouteEntry &a, const RouteEntry &b)
+{
+    return a.departureTime < b.departureTime;
+}
+
+// Routes are identified by their scheduled departure and arrival time, delays removed
+static QPair<qint64, qint64> routeKey(const QSharedPointer<QRail::RouterEngine::Route> &route)
+{
+    return qMakePair(route->departureTime().toMSecsSinceEpoch() - 1000 * qint64(route->departureDelay()),
+                     route->arrivalTime().toMSecsSinceEpoch() - 1000 * qint64(route->arrivalDelay()));
+}
+
+// Hash of everything the user sees of a route, used to diff re-streamed routes against the model
+static uint routeContentHash(const QSharedPointer<QRail::RouterEngine::Route> &route)
+{
+    uint hash = 0;
+    foreach (QRail::RouterEngine::Transfer *transfer, route->transfers()) {
+        hash = 31 * hash + qHash(transfer->station()->uri());
+        hash = 31 * hash + qHash(transfer->time().toMSecsSinceEpoch());
+        hash = 31 * hash + qHash(transfer->delay());
+        hash = 31 * hash + qHash(transfer->platform());
+        hash = 31 * hash + (transfer->isCanceled() ? 1 : 0);
+    }
+    return hash;
+}
+
+static RouteEntry createEntry(const QSharedPointer<QRail::RouterEngine::Route> &route)
+{
+    RouteEntry entry;
+    entry.route = route;
+    entry.key = routeKey(route);
+    entry.contentHash = routeContentHash(route);
+    entry.departureTime = route->departureTime();
+    return entry;
+}
+
+Router::Router(QObject *parent) : QAbstractListModel(parent), m_query("router", "Router query")
 {
     // Register custom types to the Qt meta object system
     qRegisterMetaType<Trip *>("Trip *");
@@ -24,25 +61,43 @@ Router::Router(QObject *parent) : QAbstractListModel(parent)
     qRegisterMetaType<QList<QSharedPointer<QRail::RouterEngine::Route> >>("QList<QRail::RouterEngine::Route *>");
     qRegisterMetaType<QRail::VehicleEngine::Vehicle *>("QRail::VehicleEngine::Vehicle *");
 
-    // Retrieve the QRail::RouterEngine::Planner instance and connect its signals
-    m_planner = QRail::RouterEngine::Planner::getInstance();
-    connect(m_planner,
+    // Every router has its own session on the QRail::RouterEngine::Planner
+    m_session = new RouterSession(this);
+    connect(m_session,
             SIGNAL(finished(QRail::RouterEngine::Journey *)),
             this,
             SLOT(handleFinished(QRail::RouterEngine::Journey *)));
-    connect(m_planner,
+    connect(m_session,
             SIGNAL(stream(QSharedPointer<QRail::RouterEngine::Route>)),
             this,
             SLOT(handleStream(QSharedPointer<QRail::RouterEngine::Route>)));
-    connect(m_planner,
+    connect(m_session,
             SIGNAL(processing(QUrl)),
             this,
             SLOT(handleProcessing(QUrl)));
-    connect(m_planner, SIGNAL(updateReceived(qint64)), this, SLOT(updateReceived(qint64)));
+    connect(m_session, SIGNAL(error(QString)), this, SLOT(handleError(QString)));
+    connect(m_session, SIGNAL(updateReceived(qint64)), this, SLOT(updateReceived(qint64)));
+
+    // Pages are fetched ahead of the planner into the page cache
+    m_prefetcher = new Prefetcher(this);
+
+    // Trip models are kept around until their route is replaced, cost is the number of transfers
+    m_trips.setMaxCost(TRIP_CACHE_MAX_COST);
+
+    // Metrics are shared by all routers
+    Metrics *metrics = Metrics::getInstance();
+    m_pagesFetched = metrics->counter("pages_fetched");
+    m_routesStreamed = metrics->counter("routes_streamed");
+    m_routeReplacements = metrics->counter("route_replacements");
+    m_duplicatesSkipped = metrics->counter("duplicates_skipped");
+    m_queryLatency = metrics->histogram("router_query_ms");
+    m_updateLatency = metrics->histogram("update_to_display_ms");
 
     // Init variables
-    m_routes = QList<QSharedPointer<QRail::RouterEngine::Route> >();
+    m_routes = QList<RouteEntry>();
     m_busy = false;
+    m_isUpdate = false;
+    m_maxTransfers = 0;
 }
 
 QHash<int, QByteArray> Router::roleNames() const
@@ -63,11 +118,9 @@ QVariant Router::data(const QModelIndex &index, int role) const
         return QVariant();
     }
     // Break not needed since return makes the rest unreachable.
-    QSharedPointer<Trip> trip; // http://www.cplusplus.com/forum/beginner/48287/
     switch (role) {
     case tripRole:
-        trip = QSharedPointer<Trip>(new Trip(m_routes.at(index.row())->transfers()), &QObject::deleteLater);
-        return QVariant::fromValue(trip);
+        return QVariant::fromValue(this->tripOf(m_routes.at(index.row()).route));
     default:
         return QVariant();
     }
@@ -79,138 +132,224 @@ void Router::getConnections(const QString &departureStation,
                             const quint16 &maxTransfers)
 {
     if (!this->isBusy()) {
-        this->setBusy(true);
-        m_before = QDateTime::currentMSecsSinceEpoch();
+        m_departureStation = QUrl(departureStation);
+        m_arrivalStation = QUrl(arrivalStation);
+        m_departureTime = departureTime.toUTC();
+        m_maxTransfers = maxTransfers;
         this->clearRoutes();
-        qDebug() << "DEPARTURE TIME ROUTER:" << departureTime.toUTC();
-        m_planner->getConnections(QUrl(departureStation),
-                                  QUrl(arrivalStation),
-                                  departureTime.toUTC(),
-                                  maxTransfers);
+        lcDebug(lcRouter) << "DEPARTURE TIME ROUTER:" << departureTime.toUTC();
+        this->plan(m_departureTime);
     }
 }
 
+void Router::loadNext()
+{
+    // Later departures are added to the routes, the planner continues after the last one
+    if (m_departureStation.isValid() && !this->isBusy()) {
+        lcInfo(lcRouter) << "Extending routes NEXT";
+        const QDateTime last = m_routes.isEmpty() ? m_departureTime : m_routes.last().departureTime.toUTC();
+        this->plan(last.addSecs(ROUTER_NEXT_OFFSET));
+    }
+}
+
+void Router::loadPrevious()
+{
+    // Earlier departures only: the slice ends at the first route shown, like loadNext starts at the last one
+    if (m_departureStation.isValid() && !this->isBusy()) {
+        lcInfo(lcRouter) << "Extending routes PREVIOUS";
+        const QDateTime first = m_routes.isEmpty() ? m_departureTime
+                                                   : QDateTime::fromMSecsSinceEpoch(m_routes.first().key.first, Qt::UTC);
+        m_departureTime = first.addSecs(-ROUTER_PREVIOUS_WINDOW);
+        this->plan(m_departureTime, first);
+    }
+}
+
+void Router::plan(const QDateTime &departureTime, const QDateTime &until)
+{
+    this->setBusy(true);
+    m_sliceEnd = until;
+    if (until.isValid()) {
+        m_prefetcher->prefetch(departureTime, until); // Only the pages of the slice
+    }
+    else {
+        this->prefetch(departureTime); // Keeps fetching ahead of the planner
+    }
+    m_query.start();
+    m_isUpdate = false;
+    m_session->getConnections(m_departureStation, m_arrivalStation, departureTime, m_maxTransfers);
+}
+
+void Router::prefetch(const QDateTime &departureTime)
+{
+    m_prefetcher->prefetch(departureTime, departureTime.addSecs(ROUTER_PREFETCH_WINDOW));
+}
+
 void Router::clearRoutes()
 {
     this->beginResetModel();
     m_routes.clear();
-    // clear journey here
+    m_routesIndex.clear();
+    m_trips.clear();
+    m_session->unwatch(); // Journeys of the cleared routes
     this->endResetModel();
 }
 
 void Router::abortCurrentOperation()
 {
     if(this->isBusy()) {
-        qDebug() << "Abort Planner";
-        m_planner->abortCurrentOperation();
-        m_planner->unwatchAll();
+        lcInfo(lcRouter) << "Abort Planner";
+        m_prefetcher->cancel();
+        m_session->cancel();
+        m_session->unwatch();
+        this->setBusy(false);
     }
 }
 
 void Router::handleStream(QSharedPointer<QRail::RouterEngine::Route> route)
 {
-    qDebug() << "***************** CSA STREAM ********************";
-    qDebug() << "Inserting:" << route->departureTime() << "|" << route->arrivalTime();
+    TRACE_SPAN("model", "Router::handleStream");
+    lcDebug(lcRouter) << "Inserting:" << route->departureTime() << "|" << route->arrivalTime();
     this->setBusy(true);
+    m_routesStreamed->add();
+
+    // Routes from the first shown one on belong to the later slices, they're kept as they are
+    const RouteEntry entry = createEntry(route);
+    if (m_sliceEnd.isValid() && !m_isUpdate && entry.key.first >= m_sliceEnd.toMSecsSinceEpoch()) {
+        return;
+    }
+    if (this->mergeRoute(entry)) {
+        // Notify user
+        NotificationScheduler::getInstance()->schedule(QString("%1-%2").arg(entry.key.first).arg(entry.key.second),
+                                                       "Route updated!",
+                                                       "Route from " + route->departureStation()->departure()->station()->name().value(QLocale::Language::Dutch)
+                                                       + " (" + route->departureTime().toLocalTime().toString("hh:mm") + ") to "
+                                                       + route->arrivalStation()->arrival()->station()->name().value(QLocale::Language::Dutch)
+                                                       + " (" + route->arrivalTime().toLocalTime().toString("hh:mm") + ") has been updated.",
+                                                       "social",
+                                                       "lcrail-route-update");
+    }
+}
+
+bool Router::mergeRoute(const RouteEntry &entry)
+{
+    // New route
+    QHash<QPair<qint64, qint64>, RouteEntry>::const_iterator previous = m_routesIndex.constFind(entry.key);
+    if (previous == m_routesIndex.constEnd()) {
+        m_routesIndex.insert(entry.key, entry);
+        this->insertRoute(entry);
+        return false;
+    }
+
+    // The planner still re-plans the whole journey on an update and re-streams every route.
+    // Only routes which changed somewhere (a transfer delay, platform or cancellation too)
+    // are replaced in the model, the others keep their row and trip.
+    if (previous->contentHash == entry.contentHash) {
+        m_duplicatesSkipped->add();
+        return false;
+    }
+    lcInfo(lcRouter) << "Route affected, replacing:" << entry.departureTime;
+    m_routeReplacements->add();
+    const RouteEntry replaced = previous.value();
+    m_routesIndex.insert(entry.key, entry);
+    m_trips.remove(replaced.route.data());
+    this->replaceRoute(replaced, entry);
+    return true;
+}
+
+QSharedPointer<Trip> Router::tripOf(const QSharedPointer<QRail::RouterEngine::Route> &route) const
+{
+    QSharedPointer<Trip> *cached = m_trips.object(route.data());
+    if (cached) {
+        return *cached;
+    }
+
+    // http://www.cplusplus.com/forum/beginner/48287/
+    QSharedPointer<Trip> trip = QSharedPointer<Trip>(new Trip(route->transfers()), &QObject::deleteLater);
+    m_trips.insert(route.data(), new QSharedPointer<Trip>(trip), qMax(1, route->transfers().length()));
+    return trip;
+}
 
-    QDateTime newEntryDepartureTime = route->departureTime();
-    for (qint16 i = 0; i < m_routes.length(); i++) {
-        QDateTime entryDepartureTime = m_routes.at(i)->departureTime();
-
-        // Remove duplicates (updates)
-        if((m_routes.at(i)->departureTime().addSecs(-m_routes.at(i)->departureDelay()) == route->departureTime().addSecs(-route->departureDelay()))
-            && (m_routes.at(i)->arrivalTime().addSecs(-m_routes.at(i)->arrivalDelay()) == route->arrivalTime().addSecs(-route->arrivalDelay()))) {
-            qDebug() << "FOUND ROUTE! CHECKING DELAYS";
-            qDebug() << "CHECK ROUTE:"
-                     << "DEPARTURE:" << m_routes.at(i)->departureTime().toString(Qt::ISODate) << "+" << m_routes.at(i)->departureDelay() << "vs" << route->departureTime().toString(Qt::ISODate) << "+" << route->departureDelay()
-                     << "ARRIVAL:" << m_routes.at(i)->arrivalTime().toString(Qt::ISODate) << "+" << m_routes.at(i)->arrivalDelay() << "vs" << route->arrivalTime().toString(Qt::ISODate) << "+" << route->arrivalDelay();
-
-            foreach(QRail::RouterEngine::Transfer *transfer, route->transfers()) {
-                if (transfer->type() == QRail::RouterEngine::Transfer::Type::TRANSFER) {
-                    qDebug() << "TRANSFER:"
-                             << "Changing vehicle at"
-                             << transfer->time().time().toString("hh:mm")
-                             << transfer->station()->name().value(QLocale::Language::Dutch)
-                             << transfer->arrivalLeg()->vehicleInformation()->uri()
-                             << transfer->departureLeg()->vehicleInformation()->uri();
-                } else if (transfer->type() == QRail::RouterEngine::Transfer::Type::DEPARTURE) {
-                    qDebug() << "DEPARTURE:"
-                             << transfer->time().time().toString("hh:mm")
-                             << transfer->station()->name().value(QLocale::Language::Dutch)
-                             << transfer->departureLeg()->vehicleInformation()->uri();
-                } else if (transfer->type() == QRail::RouterEngine::Transfer::Type::ARRIVAL) {
-                    qDebug() << "ARRIVAL:"
-                             << transfer->time().time().toString("hh:mm")
-                             << transfer->station()->name().value(QLocale::Language::Dutch)
-                             << transfer->arrivalLeg()->vehicleInformation()->uri();
-                }
-            }
-
-            if(m_routes.at(i)->departureDelay() != route->departureDelay() || m_routes.at(i)->arrivalDelay() != route->arrivalDelay()) {
-                qDebug() << "ROUTE AFFECTED, REPLACING...";
-
-                // Remove old entry
-                this->beginRemoveRows(QModelIndex(), i, i);
-                m_routes.removeAt(i);
-                this->endRemoveRows();
-
-                // Insert new entry
-                this->beginInsertRows(QModelIndex(), i, i);
-                m_routes.insert(i, route);
-                this->endInsertRows();
-
-                // Notify user
-                SailfishOS::createNotification("Route updated!",
-                                               "Route from " + route->departureStation()->departure()->station()->name().value(QLocale::Language::Dutch)
-                                               + " (" + route->departureTime().toLocalTime().toString("hh:mm") + ") to "
-                                               + route->arrivalStation()->arrival()->station()->name().value(QLocale::Language::Dutch)
-                                               + " (" + route->arrivalTime().toLocalTime().toString("hh:mm") + ") has been updated.",
-                                               "social",
-                                               "lcrail-liveboard-update");
-            }
-
-            return;
-        }
-
-        // TO DO: Smarter inserting: Departure and arrival time are now the same, so this works for now
-        if (entryDepartureTime > newEntryDepartureTime) {
-            this->beginInsertRows(QModelIndex(), i, i);
-            m_routes.insert(i, route);
-            this->endInsertRows();
-            return;
-        }
-    }
-
-    // Entry should be added in front or at the end of the list (if not found above)
-    this->beginInsertRows(QModelIndex(), m_routes.length(), m_routes.length());
-    m_routes.append(route);
+qint32 Router::rowOf(const RouteEntry &entry) const
+{
+    // Binary search the first route with the same departure time, then look for the route itself
+    qint32 row = std::lower_bound(m_routes.begin(), m_routes.end(), entry, departsBefore) - m_routes.begin();
+    while (row < m_routes.length() && m_routes.at(row).key != entry.key) {
+        row++;
+    }
+    return row < m_routes.length() ? row : -1;
+}
+
+void Router::insertRoute(const RouteEntry &entry)
+{
+    TRACE_SPAN("model", "Router::insertRoute");
+    // Routes with the same departure time are kept in the order they're received
+    const qint32 row = std::upper_bound(m_routes.begin(), m_routes.end(), entry, departsBefore) - m_routes.begin();
+    this->beginInsertRows(QModelIndex(), row, row);
+    m_routes.insert(row, entry);
     this->endInsertRows();
 }
 
+void Router::replaceRoute(const RouteEntry &previous, const RouteEntry &entry)
+{
+    TRACE_SPAN("model", "Router::replaceRoute");
+    const qint32 row = this->rowOf(previous);
+    if (row < 0) {
+        this->insertRoute(entry);
+        return;
+    }
+
+    // Position is searched while the previous route is still in the list,
+    // right before or right after it means the row stays in place.
+    const qint32 target = std::upper_bound(m_routes.begin(), m_routes.end(), entry, departsBefore) - m_routes.begin();
+    if (target == row || target == row + 1) {
+        m_routes.replace(row, entry);
+        emit this->dataChanged(this->index(row), this->index(row));
+        return;
+    }
+
+    const qint32 destination = target > row ? target - 1 : target;
+    this->beginMoveRows(QModelIndex(), row, row, QModelIndex(), target);
+    m_routes.move(row, destination);
+    m_routes.replace(destination, entry);
+    this->endMoveRows();
+    emit this->dataChanged(this->index(destination), this->index(destination));
+}
+
 void Router::handleFinished(QRail::RouterEngine::Journey *journey)
 {
-    m_planner->unwatchAll();
-    m_planner->watch(journey);
-    qDebug() << "Finished routing";
-    m_after = QDateTime::currentMSecsSinceEpoch();
-    qDebug() << "AFTER:" << m_after;
-    qDebug() << "BEFORE:" << m_before;
-    emit this->benchmark(m_after - m_before);
+    m_prefetcher->cancel(); // Pages the planner didn't need anymore
+    m_session->watch(journey);
+    lcInfo(lcRouter) << "Finished routing";
+    const qint64 elapsed = m_query.finish();
+    (m_isUpdate ? m_updateLatency : m_queryLatency)->record(elapsed);
+    emit this->benchmark(elapsed);
+    this->setBusy(false);
+}
+
+void Router::handleError(const QString &message)
+{
+    lcWarning(lcRouter) << "Routing failed:" << message;
+    m_prefetcher->cancel();
     this->setBusy(false);
+    emit this->error(message);
 }
 
 void Router::handleProcessing(const QUrl &uri)
 {
+    TRACE_INSTANT("network", "Router page", uri.toString());
+    m_pagesFetched->add();
     // Task started or running
     QUrlQuery query = QUrlQuery(uri);
     QDateTime timestamp = QDateTime::fromString(query.queryItemValue("departureTime"), Qt::ISODate);
+    m_prefetcher->consumed(timestamp);
     emit this->processing(uri.toString(), timestamp);
 }
 
 void Router::updateReceived(qint64 time)
 {
     this->setBusy(true);
-    m_before = time;
+    m_query.startAt(time);
+    m_isUpdate = true;
 }
 
 // Getters & Setters
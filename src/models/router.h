@@ -26,14 +26,34 @@
 #include <QtCore/QModelIndex>
 #include <QtCore/QList>
 #include <QtCore/QHash>
+#include <QtCore/QPair>
 #include <QtCore/QByteArray>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QCache>
+#include <algorithm>
 
 #include "engines/router/routerplanner.h"
 #include "engines/router/routerroute.h"
 #include "engines/vehicle/vehiclevehicle.h"
 #include "trip.h"
 #include "../sailfishos.h"
+#include "../notificationscheduler.h"
+#include "../logging.h"
+#include "../tracing/tracer.h"
+#include "../metrics/metrics.h"
+#include "../network/prefetcher.h"
+#include "../sessions/routersession.h"
+#define TRIP_CACHE_MAX_COST 1000 // transfers
+#define ROUTER_PREFETCH_WINDOW 7200 // seconds after the departure time
+#define ROUTER_PREVIOUS_WINDOW 3600 // seconds of earlier departures before the first route, added by loadPrevious
+#define ROUTER_NEXT_OFFSET 60 // seconds after the last route where loadNext continues
+
+struct RouteEntry {
+    QSharedPointer<QRail::RouterEngine::Route> route;
+    QPair<qint64, qint64> key; // scheduled (departure, arrival)
+    uint contentHash; // delays, platforms and cancellations of every transfer
+    QDateTime departureTime;
+};
 
 class Router : public QAbstractListModel
 {
@@ -51,6 +71,9 @@ public:
                                     const QString &arrivalStation,
                                     const QDateTime &departureTime,
                                     const quint16 &maxTransfers);
+    Q_INVOKABLE void prefetch(const QDateTime &departureTime);
+    Q_INVOKABLE void loadNext();
+    Q_INVOKABLE void loadPrevious();
     Q_INVOKABLE void clearRoutes();
     Q_INVOKABLE void abortCurrentOperation();
     bool isBusy() const;
@@ -58,25 +81,48 @@ public:
 signals:
     void busyChanged();
     void processing(const QString &uri, const QDateTime &timestamp);
+    void error(const QString &message);
     void benchmark(qint64 time);
 
 private slots:
     void handleStream(QSharedPointer<QRail::RouterEngine::Route> route);
     void handleFinished(QRail::RouterEngine::Journey *journey);
     void handleProcessing(const QUrl &uri);
+    void handleError(const QString &message);
     void updateReceived(qint64 time);
 
 protected:
     QHash<int, QByteArray> roleNames() const override;
 
 private:
-    qint64 m_before;
-    qint64 m_after;
-    QRail::RouterEngine::Planner *m_planner;
-    QList<QSharedPointer<QRail::RouterEngine::Route> > m_routes;
+    friend class TestRouter;
+    TraceInterval m_query; // request or realtime update until the model is complete
+    bool m_isUpdate;
+    Counter *m_pagesFetched;
+    Counter *m_routesStreamed;
+    Counter *m_routeReplacements;
+    Counter *m_duplicatesSkipped;
+    Histogram *m_queryLatency;
+    Histogram *m_updateLatency;
+    RouterSession *m_session;
+    Prefetcher *m_prefetcher;
+    QList<RouteEntry> m_routes;
+    QHash<QPair<qint64, qint64>, RouteEntry> m_routesIndex; // scheduled (departure, arrival) -> route
+    mutable QCache<QRail::RouterEngine::Route *, QSharedPointer<Trip> > m_trips;
     bool m_busy;
     bool m_isCancelled;
+    QUrl m_departureStation;
+    QUrl m_arrivalStation;
+    QDateTime m_departureTime;
+    QDateTime m_sliceEnd; // scheduled departure of the first route when loading earlier routes, invalid otherwise
+    quint16 m_maxTransfers;
     void setBusy(const bool &busy);
+    void plan(const QDateTime &departureTime, const QDateTime &until = QDateTime());
+    QSharedPointer<Trip> tripOf(const QSharedPointer<QRail::RouterEngine::Route> &route) const;
+    bool mergeRoute(const RouteEntry &entry);
+    qint32 rowOf(const RouteEntry &entry) const;
+    void insertRoute(const RouteEntry &entry);
+    void replaceRoute(const RouteEntry &previous, const RouteEntry &entry);
 };
 
 #endif // ROUTER_H
@@ -0,0 +1,65 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "stationdensity.h"
+
+StationDensity *StationDensity::m_instance = nullptr;
+
+StationDensity::StationDensity(QObject *parent) : QObject(parent)
+{
+    m_settings = new QSettings(this);
+    m_settings->beginGroup(STATION_DENSITY_GROUP);
+    foreach (const QString &key, m_settings->childKeys()) {
+        m_density.insert(QUrl::fromPercentEncoding(key.toLatin1()), m_settings->value(key).toReal());
+    }
+    m_settings->endGroup();
+}
+
+StationDensity *StationDensity::getInstance()
+{
+    if (m_instance == nullptr) {
+        lcDebug(lcStations) << "Creating new StationDensity";
+        m_instance = new StationDensity();
+    }
+    return m_instance;
+}
+
+void StationDensity::record(const QUrl &station, const qint32 &entries, const qint64 &seconds)
+{
+    if (!station.isValid() || seconds <= 0) {
+        return;
+    }
+
+    // Moving average, the timetable of a station changes during the day
+    const QString uri = station.toString();
+    const qreal observed = 3600.0 * entries / seconds;
+    const qreal density = m_density.contains(uri)
+            ? STATION_DENSITY_WEIGHT * observed + (1 - STATION_DENSITY_WEIGHT) * m_density.value(uri)
+            : observed;
+    m_density.insert(uri, density);
+    m_settings->setValue(QString(STATION_DENSITY_GROUP) + "/" + QString::fromLatin1(QUrl::toPercentEncoding(uri)), density);
+}
+
+qint64 StationDensity::window(const QUrl &station, const qint64 &fallback) const
+{
+    // Enough time for the target number of rows, unknown stations get the fallback
+    const qreal density = m_density.value(station.toString(), 0);
+    if (density <= 0) {
+        return fallback;
+    }
+    const qint64 window = qint64(3600.0 * LIVEBOARD_TARGET_ROWS / density);
+    return qBound(qint64(LIVEBOARD_MIN_WINDOW), window, qint64(LIVEBOARD_MAX_WINDOW));
+}
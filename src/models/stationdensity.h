@@ -0,0 +1,51 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef STATIONDENSITY_H
+#define STATIONDENSITY_H
+
+#include <QtCore/QObject>
+#include <QtCore/QHash>
+#include <QtCore/QSettings>
+#include <QtCore/QString>
+#include <QtCore/QUrl>
+
+#include "../logging.h"
+
+#define STATION_DENSITY_GROUP "density"
+#define STATION_DENSITY_WEIGHT 0.5 // weight of a new observation in the moving average
+#define LIVEBOARD_TARGET_ROWS 40 // rows the first window of a liveboard should fill
+#define LIVEBOARD_MIN_WINDOW 1800 // seconds
+#define LIVEBOARD_MAX_WINDOW (6 * 3600) // seconds
+
+// Observed departures per hour of every station, kept across restarts.
+// Liveboard windows are sized from it: short at busy stations, long at rural halts.
+class StationDensity : public QObject
+{
+    Q_OBJECT
+public:
+    static StationDensity *getInstance();
+    void record(const QUrl &station, const qint32 &entries, const qint64 &seconds);
+    qint64 window(const QUrl &station, const qint64 &fallback) const;
+
+private:
+    explicit StationDensity(QObject *parent = nullptr);
+    static StationDensity *m_instance;
+    QSettings *m_settings;
+    QHash<QString, qreal> m_density; // station URI -> departures per hour
+};
+
+#endif // STATIONDENSITY_H
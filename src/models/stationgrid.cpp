@@ -0,0 +1,109 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "stationgrid.h"
+
+StationGrid::StationGrid()
+{
+    m_minRow = 0;
+    m_maxRow = -1;
+    m_minColumn = 0;
+    m_maxColumn = -1;
+}
+
+QPair<qint32, qint32> StationGrid::cellOf(const QGeoCoordinate &coordinate)
+{
+    return qMakePair(qFloor(coordinate.latitude() / STATION_GRID_CELL_SIZE),
+                     qFloor(coordinate.longitude() / STATION_GRID_CELL_SIZE));
+}
+
+void StationGrid::build(const QVector<QGeoCoordinate> &positions)
+{
+    m_positions = positions;
+    m_cells.clear();
+    bool first = true;
+    for (qint32 s = 0; s < positions.length(); s++) {
+        if (!positions.at(s).isValid()) {
+            continue;
+        }
+
+        const QPair<qint32, qint32> cell = StationGrid::cellOf(positions.at(s));
+        m_cells[cell].append(s);
+        m_minRow = first ? cell.first : qMin(m_minRow, cell.first);
+        m_maxRow = first ? cell.first : qMax(m_maxRow, cell.first);
+        m_minColumn = first ? cell.second : qMin(m_minColumn, cell.second);
+        m_maxColumn = first ? cell.second : qMax(m_maxColumn, cell.second);
+        first = false;
+    }
+}
+
+QVector<QPair<qint32, qreal> > StationGrid::nearest(const QGeoCoordinate &coordinate, const qint32 &k) const
+{
+    QVector<QPair<qint32, qreal> > results;
+    if (m_cells.isEmpty() || !coordinate.isValid() || k <= 0) {
+        return results;
+    }
+
+    // Search ring by ring around the cell of the coordinate. A station in ring r is at least
+    // (r - 1) cells away, once the k-th best distance is below that the search is complete.
+    const QPair<qint32, qint32> center = StationGrid::cellOf(coordinate);
+    const qreal ringDistance = STATION_GRID_CELL_SIZE * METERS_PER_DEGREE
+            * qMax(0.1, qCos(qDegreesToRadians(coordinate.latitude())));
+    const qint32 maxRing = qMax(qMax(qAbs(center.first - m_minRow), qAbs(m_maxRow - center.first)),
+                                qMax(qAbs(center.second - m_minColumn), qAbs(m_maxColumn - center.second)));
+
+    QVector<QPair<qreal, qint32> > heap; // max-heap of the k best (distance, station)
+    for (qint32 r = 0; r <= maxRing; r++) {
+        if (heap.length() == k && (r - 1) * ringDistance > heap.first().first) {
+            break;
+        }
+
+        for (qint32 dr = -r; dr <= r; dr++) {
+            for (qint32 dc = -r; dc <= r; dc++) {
+                // Only the border of the ring, the inside has been visited already
+                if (qMax(qAbs(dr), qAbs(dc)) != r) {
+                    continue;
+                }
+
+                QHash<QPair<qint32, qint32>, QVector<qint32> >::const_iterator cell =
+                        m_cells.constFind(qMakePair(center.first + dr, center.second + dc));
+                if (cell == m_cells.constEnd()) {
+                    continue;
+                }
+
+                foreach (qint32 s, cell.value()) {
+                    const qreal distance = coordinate.distanceTo(m_positions.at(s));
+                    if (heap.length() < k) {
+                        heap.append(qMakePair(distance, s));
+                        std::push_heap(heap.begin(), heap.end());
+                    }
+                    else if (distance < heap.first().first) {
+                        std::pop_heap(heap.begin(), heap.end());
+                        heap.last() = qMakePair(distance, s);
+                        std::push_heap(heap.begin(), heap.end());
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end());
+    results.reserve(heap.length());
+    for (qint32 i = 0; i < heap.length(); i++) {
+        results.append(qMakePair(heap.at(i).second, heap.at(i).first));
+    }
+    return results;
+}
@@ -0,0 +1,48 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef STATIONGRID_H
+#define STATIONGRID_H
+
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QVector>
+#include <QtCore/QtMath>
+#include <QtPositioning/QGeoCoordinate>
+#include <algorithm>
+
+#define STATION_GRID_CELL_SIZE 0.05 // degrees, about 5 km in Belgium
+#define METERS_PER_DEGREE 111320.0
+
+// Uniform latitude/longitude grid over the station positions for nearest station lookups
+class StationGrid
+{
+public:
+    StationGrid();
+    void build(const QVector<QGeoCoordinate> &positions);
+    QVector<QPair<qint32, qreal> > nearest(const QGeoCoordinate &coordinate, const qint32 &k) const;
+
+private:
+    QHash<QPair<qint32, qint32>, QVector<qint32> > m_cells; // (row, column) -> stations
+    QVector<QGeoCoordinate> m_positions;
+    qint32 m_minRow;
+    qint32 m_maxRow;
+    qint32 m_minColumn;
+    qint32 m_maxColumn;
+    static QPair<qint32, qint32> cellOf(const QGeoCoordinate &coordinate);
+};
+
+#endif // STATIONGRID_H
@@ -0,0 +1,261 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "stationindex.h"
+
+StationIndex *StationIndex::m_instance = nullptr;
+
+static bool prefixLessThan(const QPair<QString, qint32> &a, const QPair<QString, qint32> &b)
+{
+    return a.first < b.first;
+}
+
+static bool isCanceled(const QAtomicInt *generation, const int expected)
+{
+    return generation && generation->load() != expected;
+}
+
+// Runs in a worker thread, only plain data is touched here
+StationIndex::Index *StationIndex::buildIndex(QVector<QRail::StationEngine::Station *> stations,
+                                              QVector<QStringList> names,
+                                              QVector<QGeoCoordinate> positions)
+{
+    TRACE_SPAN("search", "StationIndex::buildIndex");
+    StationIndex::Index *index = new StationIndex::Index();
+    index->stations = stations;
+    index->grid.build(positions);
+
+    // Names of every language, normalized once here instead of on the GUI thread
+    for (qint32 s = 0; s < names.length(); s++) {
+        QStringList stationNames;
+        foreach (const QString &name, names.at(s)) {
+            const QString normalized = StationIndex::normalize(name);
+            if (!normalized.isEmpty() && !stationNames.contains(normalized)) {
+                stationNames.append(normalized);
+            }
+        }
+        names[s] = stationNames;
+    }
+    index->names = names;
+
+    for (qint32 s = 0; s < names.length(); s++) {
+        foreach (const QString &name, names.at(s)) {
+            // Prefixes: the complete name and every word in it
+            index->prefixes.append(qMakePair(name, s));
+            const QStringList words = name.split(QRegExp("[\\s\\-/()]+"), QString::SkipEmptyParts);
+            for (qint32 w = 1; w < words.length(); w++) {
+                index->prefixes.append(qMakePair(words.at(w), s));
+            }
+
+            // Trigrams, stations are visited in order so posting lists stay sorted
+            for (qint32 i = 0; i + 3 <= name.length(); i++) {
+                QVector<qint32> &posting = index->trigrams[name.mid(i, 3)];
+                if (posting.isEmpty() || posting.last() != s) {
+                    posting.append(s);
+                }
+            }
+        }
+    }
+    std::sort(index->prefixes.begin(), index->prefixes.end(), prefixLessThan);
+    return index;
+}
+
+StationIndex::StationIndex(QObject *parent) : QObject(parent)
+{
+    m_factory = QRail::StationEngine::Factory::getInstance();
+    m_watcher = new QFutureWatcher<Index *>(this);
+    connect(m_watcher, SIGNAL(finished()), this, SLOT(handleIndexBuilt()));
+    m_index = nullptr;
+    m_loading = false;
+}
+
+StationIndex *StationIndex::getInstance()
+{
+    if (m_instance == nullptr) {
+        lcDebug(lcStations) << "Creating new StationIndex";
+        m_instance = new StationIndex();
+    }
+    return m_instance;
+}
+
+QString StationIndex::normalize(const QString &text)
+{
+    // Case and accent insensitive: "Liège" matches "liege"
+    const QString decomposed = text.normalized(QString::NormalizationForm_KD).toLower();
+    QString normalized;
+    normalized.reserve(decomposed.length());
+    for (qint32 i = 0; i < decomposed.length(); i++) {
+        if (decomposed.at(i).category() != QChar::Mark_NonSpacing) {
+            normalized.append(decomposed.at(i));
+        }
+    }
+    return normalized.simplified();
+}
+
+void StationIndex::load()
+{
+    if (m_loading || m_index) {
+        return;
+    }
+    m_loading = true;
+
+    // The station database can only be used from this thread, copy the names out of it.
+    // An empty name matches every station in the database.
+    m_stations = m_factory->getStationsByName(QString()).toVector();
+    m_names.clear();
+    m_positions.clear();
+    m_names.reserve(m_stations.length());
+    m_positions.reserve(m_stations.length());
+    QTimer::singleShot(0, this, SLOT(copyStations()));
+}
+
+void StationIndex::copyStations()
+{
+    // Copied in chunks, the GUI thread keeps handling events in between
+    const qint32 end = qMin(m_names.length() + STATION_INDEX_CHUNK, m_stations.length());
+    for (qint32 s = m_names.length(); s < end; s++) {
+        m_positions.append(m_stations.at(s)->position());
+        m_names.append(QStringList(m_stations.at(s)->name().values()));
+    }
+    if (m_names.length() < m_stations.length()) {
+        QTimer::singleShot(0, this, SLOT(copyStations()));
+        return;
+    }
+
+    m_watcher->setFuture(QtConcurrent::run(StationIndex::buildIndex, m_stations, m_names, m_positions));
+    m_stations.clear();
+    m_names.clear();
+    m_positions.clear();
+}
+
+void StationIndex::handleIndexBuilt()
+{
+    m_index = m_watcher->result();
+    m_loading = false;
+    lcInfo(lcStations) << "Station index ready:" << m_index->stations.length() << "stations";
+    emit this->ready();
+}
+
+bool StationIndex::isReady() const
+{
+    return m_index != nullptr;
+}
+
+QList<QRail::StationEngine::Station *> StationIndex::stations() const
+{
+    return m_index ? m_index->stations.toList() : QList<QRail::StationEngine::Station *>();
+}
+
+QList<QPair<QRail::StationEngine::Station *, qreal> > StationIndex::nearby(const QGeoCoordinate &coordinate,
+                                                                         const qint32 &k) const
+{
+    QList<QPair<QRail::StationEngine::Station *, qreal> > results;
+    if (!m_index) {
+        return results;
+    }
+
+    QVector<QPair<qint32, qreal> > nearest = m_index->grid.nearest(coordinate, k);
+    for (qint32 i = 0; i < nearest.length(); i++) {
+        results.append(qMakePair(m_index->stations.at(nearest.at(i).first), nearest.at(i).second));
+    }
+    return results;
+}
+
+QList<QRail::StationEngine::Station *> StationIndex::search(const QString &query,
+                                                            const QAtomicInt *generation,
+                                                            const int expected) const
+{
+    QList<QRail::StationEngine::Station *> results;
+    const QString needle = StationIndex::normalize(query);
+    if (!m_index || needle.isEmpty()) {
+        return results;
+    }
+
+    // Collect candidates: prefix range for short queries, trigram intersection otherwise
+    QVector<qint32> candidates;
+    if (needle.length() < 3) {
+        QVector<QPair<QString, qint32> >::const_iterator it = std::lower_bound(m_index->prefixes.constBegin(),
+                                                                               m_index->prefixes.constEnd(),
+                                                                               qMakePair(needle, 0),
+                                                                               prefixLessThan);
+        for (; it != m_index->prefixes.constEnd() && it->first.startsWith(needle); ++it) {
+            candidates.append(it->second);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    }
+    else {
+        // Intersect the posting lists, smallest ones first
+        QList<const QVector<qint32> *> postings;
+        for (qint32 i = 0; i + 3 <= needle.length(); i++) {
+            QHash<QString, QVector<qint32> >::const_iterator posting = m_index->trigrams.constFind(needle.mid(i, 3));
+            if (posting == m_index->trigrams.constEnd()) {
+                return results;
+            }
+            postings.append(&posting.value());
+        }
+        std::sort(postings.begin(), postings.end(),
+                  [](const QVector<qint32> *a, const QVector<qint32> *b) { return a->length() < b->length(); });
+
+        candidates = *postings.first();
+        for (qint32 p = 1; p < postings.length() && !candidates.isEmpty(); p++) {
+            if (isCanceled(generation, expected)) {
+                return results;
+            }
+            QVector<qint32> intersection;
+            std::set_intersection(candidates.constBegin(), candidates.constEnd(),
+                                  postings.at(p)->constBegin(), postings.at(p)->constEnd(),
+                                  std::back_inserter(intersection));
+            candidates = intersection;
+        }
+    }
+
+    // Verify and rank: name starts with the query, a word starts with it, or it appears somewhere
+    QVector<QPair<qint32, qint32> > ranked; // (rank, station)
+    foreach (qint32 s, candidates) {
+        if (isCanceled(generation, expected)) {
+            return results;
+        }
+        qint32 rank = -1;
+        foreach (const QString &name, m_index->names.at(s)) {
+            if (name.startsWith(needle)) {
+                rank = 0;
+                break;
+            }
+            const qint32 position = name.indexOf(needle);
+            if (position > 0) {
+                const qint32 current = name.at(position - 1).isLetterOrNumber() ? 2 : 1;
+                rank = rank < 0 ? current : qMin(rank, current);
+            }
+        }
+        if (rank >= 0) {
+            ranked.append(qMakePair(rank, s));
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(),
+              [this](const QPair<qint32, qint32> &a, const QPair<qint32, qint32> &b) {
+        if (a.first != b.first) {
+            return a.first < b.first;
+        }
+        return m_index->names.at(a.second).first() < m_index->names.at(b.second).first();
+    });
+
+    results.reserve(ranked.length());
+    for (qint32 i = 0; i < ranked.length(); i++) {
+        results.append(m_index->stations.at(ranked.at(i).second));
+    }
+    return results;
+}
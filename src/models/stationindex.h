@@ -0,0 +1,88 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef STATIONINDEX_H
+#define STATIONINDEX_H
+
+#include <QtCore/QObject>
+#include <QtCore/QList>
+#include <QtCore/QVector>
+#include <QtCore/QHash>
+#include <QtCore/QPair>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QTimer>
+#include <QtCore/QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <iterator>
+
+#include "engines/station/stationfactory.h"
+#include "engines/station/stationstation.h"
+#include "stationgrid.h"
+#include "../tracing/tracer.h"
+#include "../logging.h"
+#define STATION_INDEX_CHUNK 100 // stations copied out of the database per event loop iteration
+
+// In-memory name and position index over all stations in every language.
+// Built once in the background, afterwards search() can be called from any thread.
+class StationIndex : public QObject
+{
+    Q_OBJECT
+public:
+    struct Index {
+        QVector<QRail::StationEngine::Station *> stations;
+        QVector<QStringList> names; // normalized names of each station
+        QVector<QPair<QString, qint32> > prefixes; // sorted normalized names and words -> station
+        QHash<QString, QVector<qint32> > trigrams; // trigram -> sorted stations
+        StationGrid grid;
+    };
+    static StationIndex *getInstance();
+    static QString normalize(const QString &text);
+    static Index *buildIndex(QVector<QRail::StationEngine::Station *> stations,
+                             QVector<QStringList> names,
+                             QVector<QGeoCoordinate> positions);
+    void load();
+    bool isReady() const;
+    QList<QRail::StationEngine::Station *> stations() const;
+    QList<QRail::StationEngine::Station *> search(const QString &query,
+                                                  const QAtomicInt *generation = nullptr,
+                                                  const int expected = 0) const;
+    QList<QPair<QRail::StationEngine::Station *, qreal> > nearby(const QGeoCoordinate &coordinate,
+                                                                 const qint32 &k) const;
+
+signals:
+    void ready();
+
+private slots:
+    void copyStations();
+    void handleIndexBuilt();
+
+private:
+    friend class TestStationIndex;
+    explicit StationIndex(QObject *parent = nullptr);
+    static StationIndex *m_instance;
+    QRail::StationEngine::Factory *m_factory;
+    QFutureWatcher<Index *> *m_watcher;
+    Index *m_index;
+    bool m_loading;
+    QVector<QRail::StationEngine::Station *> m_stations; // stations of the index being loaded
+    QVector<QStringList> m_names;
+    QVector<QGeoCoordinate> m_positions;
+};
+
+#endif // STATIONINDEX_H
@@ -16,12 +16,40 @@
 */
 #include "stations.h"
 
+// Runs in a worker thread, stops early when a newer search is started
+static QList<QRail::StationEngine::Station *> searchStations(StationIndex *index,
+                                                             const QString query,
+                                                             const QSharedPointer<QAtomicInt> generation,
+                                                             const int expected)
+{
+    TRACE_SPAN("search", "StationIndex::search");
+    return index->search(query, generation.data(), expected);
+}
+
 Stations::Stations(QObject *parent) : QAbstractListModel(parent)
 {
-    m_factory = QRail::StationEngine::Factory::getInstance();
+    // Searches are performed on the shared in-memory index, which is built on first use
+    m_index = StationIndex::getInstance();
+    connect(m_index, SIGNAL(ready()), this, SLOT(handleIndexReady()));
+    m_watcher = new QFutureWatcher<QList<QRail::StationEngine::Station *> >(this);
+    connect(m_watcher, SIGNAL(finished()), this, SLOT(handleSearchFinished()));
+    m_index->load();
+
+    // Init variables
+    m_generation = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+    m_searchGeneration = 0;
+    m_positionSource = nullptr;
+    m_nearbyCount = 0;
+    m_nearestStation = nullptr;
     m_busy = false;
 }
 
+Stations::~Stations()
+{
+    // Cancel the running searches, they share the generation counter so it outlives us
+    m_generation->ref();
+}
+
 int Stations::rowCount(const QModelIndex &) const
 {
     return m_results.count();
@@ -39,6 +67,9 @@ QVariant Stations::data(const QModelIndex &index, int role) const
     case NameRole:
         return QVariant(m_results.at(index.row())->name().value(
                             QLocale::Dutch)); // TO DO localize using QLocale::system().language
+    case DistanceRole:
+        // Only available for nearby searches
+        return index.row() < m_distances.length() ? QVariant(m_distances.at(index.row())) : QVariant();
     default:
         return QVariant();
     }
@@ -46,25 +77,136 @@ QVariant Stations::data(const QModelIndex &index, int role) const
 
 void Stations::searchByName(const QString &name)
 {
-    // TO DO: Smarter inserting algorithm, even better: search tree
+    // Every keystroke cancels the running search, its results are dropped
+    this->stopNearbyUpdates();
+    m_nearbyPosition = QGeoCoordinate();
+    m_query = name;
+    m_searchGeneration = m_generation->fetchAndAddOrdered(1) + 1;
+    if (name.length() == 0) {
+        this->clearSearch();
+        this->setBusy(false);
+        return;
+    }
+
     this->setBusy(true);
-    this->clearSearch();
-    if (name.length() > 0) {
-        QList<QRail::StationEngine::Station *> stations =  m_factory->getStationsByName(name);
-        foreach (QRail::StationEngine::Station *s, stations) {
-            this->beginInsertRows(QModelIndex(), m_results.length(), m_results.length());
-            m_results.append(s);
-            this->endInsertRows();
+
+    // Search is started as soon as the index is ready
+    if (!m_index->isReady()) {
+        return;
+    }
+
+    m_watcher->setFuture(QtConcurrent::run(searchStations, m_index, name, m_generation, m_searchGeneration));
+}
+
+void Stations::clearSearch()
+{
+    this->setResults(QList<QRail::StationEngine::Station *>());
+}
+
+void Stations::searchNearby(const QGeoCoordinate &coordinate, const quint32 &k)
+{
+    // Cancel any running name search
+    m_query.clear();
+    m_searchGeneration = m_generation->fetchAndAddOrdered(1) + 1;
+    m_nearbyPosition = coordinate;
+    m_nearbyCount = k;
+
+    // Search is started as soon as the index is ready
+    if (!m_index->isReady()) {
+        this->setBusy(true);
+        return;
+    }
+
+    // Only the grid cells around the coordinate are visited, the catalog isn't sorted
+    QList<QRail::StationEngine::Station *> stations;
+    QList<qreal> distances;
+    QList<QPair<QRail::StationEngine::Station *, qreal> > nearby = m_index->nearby(coordinate, k);
+    for (qint32 i = 0; i < nearby.length(); i++) {
+        stations.append(nearby.at(i).first);
+        distances.append(nearby.at(i).second);
+    }
+
+    // Same ranking: only the distances changed
+    if (stations == m_results && !m_results.isEmpty()) {
+        m_distances = distances;
+        emit this->dataChanged(this->index(0), this->index(m_results.length() - 1),
+                               QVector<int>() << DistanceRole);
+    }
+    else {
+        this->setResults(stations, distances);
+    }
+    this->setNearestStation(stations.isEmpty() ? nullptr : stations.first());
+    this->setBusy(false);
+}
+
+void Stations::startNearbyUpdates(const quint32 &k)
+{
+    m_nearbyCount = k;
+    if (!m_positionSource) {
+        m_positionSource = QGeoPositionInfoSource::createDefaultSource(this);
+        if (!m_positionSource) {
+            lcWarning(lcStations) << "No position source available, nearby stations can't be updated";
+            return;
         }
+        connect(m_positionSource, SIGNAL(positionUpdated(QGeoPositionInfo)),
+                this, SLOT(handlePositionUpdated(QGeoPositionInfo)));
     }
+
+    // Rank immediately with the last known position, GPS fixes take a while
+    const QGeoPositionInfo last = m_positionSource->lastKnownPosition();
+    if (last.isValid()) {
+        this->searchNearby(last.coordinate(), k);
+    }
+    m_positionSource->startUpdates();
+}
+
+void Stations::stopNearbyUpdates()
+{
+    if (m_positionSource) {
+        m_positionSource->stopUpdates();
+    }
+}
+
+void Stations::handlePositionUpdated(const QGeoPositionInfo &info)
+{
+    // Small movements can't change the ranking in a meaningful way
+    if (m_nearbyPosition.isValid() && m_index->isReady()
+            && m_nearbyPosition.distanceTo(info.coordinate()) < NEARBY_MIN_DISTANCE) {
+        return;
+    }
+    this->searchNearby(info.coordinate(), m_nearbyCount);
+}
+
+void Stations::handleIndexReady()
+{
+    if (m_query.length() > 0) {
+        this->searchByName(m_query);
+    }
+    else if (m_nearbyPosition.isValid()) {
+        this->searchNearby(m_nearbyPosition, m_nearbyCount);
+    }
+}
+
+void Stations::handleSearchFinished()
+{
+    // Stale result of a previous keystroke
+    if (m_searchGeneration != m_generation->load()) {
+        return;
+    }
+
+    this->setResults(m_watcher->result());
     this->setBusy(false);
 }
 
-void Stations::clearSearch()
+void Stations::setResults(const QList<QRail::StationEngine::Station *> &results,
+                          const QList<qreal> &distances)
 {
+    // Complete result set is delivered as a single model update
     this->beginResetModel();
-    m_results.clear();
+    m_results = results;
+    m_distances = distances;
     this->endResetModel();
+    emit this->stationsUpdated();
 }
 
 QHash<int, QByteArray> Stations::roleNames() const
@@ -72,6 +214,7 @@ QHash<int, QByteArray> Stations::roleNames() const
     QHash<int, QByteArray> roles;
     roles[URIRole] = "URI";
     roles[NameRole] = "name";
+    roles[DistanceRole] = "distance";
     return roles;
 }
 
@@ -81,6 +224,24 @@ bool Stations::busy() const
     return m_busy;
 }
 
+QString Stations::nearestStationURI() const
+{
+    return m_nearestStation ? m_nearestStation->uri().toString() : QString();
+}
+
+QString Stations::nearestStationName() const
+{
+    return m_nearestStation ? m_nearestStation->name().value(QLocale::Dutch) : QString();
+}
+
+void Stations::setNearestStation(QRail::StationEngine::Station *station)
+{
+    if (m_nearestStation != station) {
+        m_nearestStation = station;
+        emit this->nearestStationChanged();
+    }
+}
+
 void Stations::setBusy(bool busy)
 {
     if (m_busy != busy) {
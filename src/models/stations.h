@@ -19,39 +19,76 @@
 
 #include <QtCore/QAbstractListModel>
 #include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
+#include <QtPositioning/QGeoCoordinate>
+#include <QtPositioning/QGeoPositionInfo>
+#include <QtPositioning/QGeoPositionInfoSource>
 
 #include "engines/station/stationfactory.h"
+#include "stationindex.h"
+#define NEARBY_MIN_DISTANCE 50 // meters before the nearby stations are ranked again
 
 class Stations : public QAbstractListModel
 {
     Q_OBJECT
     Q_PROPERTY(bool busy READ busy WRITE setBusy NOTIFY busyChanged)
+    Q_PROPERTY(QString nearestStationURI READ nearestStationURI NOTIFY nearestStationChanged)
+    Q_PROPERTY(QString nearestStationName READ nearestStationName NOTIFY nearestStationChanged)
 
 public:
     enum Roles {
         URIRole = Qt::UserRole + 1,
-        NameRole = Qt::UserRole + 2
+        NameRole = Qt::UserRole + 2,
+        DistanceRole = Qt::UserRole + 3
     };
     explicit Stations(QObject *parent = nullptr);
+    ~Stations();
 
     virtual int rowCount(const QModelIndex &) const;
     virtual QVariant data(const QModelIndex &index, int role) const;
     Q_INVOKABLE void searchByName(const QString &name);
     Q_INVOKABLE void clearSearch();
+    Q_INVOKABLE void searchNearby(const QGeoCoordinate &coordinate, const quint32 &k);
+    Q_INVOKABLE void startNearbyUpdates(const quint32 &k);
+    Q_INVOKABLE void stopNearbyUpdates();
     bool busy() const;
+    QString nearestStationURI() const;
+    QString nearestStationName() const;
 
 signals:
     void stationsUpdated();
     void busyChanged();
+    void nearestStationChanged();
 
 protected:
     QHash<int, QByteArray> roleNames() const;
 
+private slots:
+    void handleIndexReady();
+    void handleSearchFinished();
+    void handlePositionUpdated(const QGeoPositionInfo &info);
+
 private:
     QList<QRail::StationEngine::Station *> m_results;
-    QRail::StationEngine::Factory *m_factory;
+    QList<qreal> m_distances;
+    StationIndex *m_index;
+    QFutureWatcher<QList<QRail::StationEngine::Station *> > *m_watcher;
+    QSharedPointer<QAtomicInt> m_generation; // shared with the running searches
+    int m_searchGeneration;
+    QString m_query;
+    QGeoPositionInfoSource *m_positionSource;
+    QGeoCoordinate m_nearbyPosition;
+    quint32 m_nearbyCount;
+    QRail::StationEngine::Station *m_nearestStation;
     bool m_busy;
     void setBusy(bool busy);
+    void setResults(const QList<QRail::StationEngine::Station *> &results,
+                    const QList<qreal> &distances = QList<qreal>());
+    void setNearestStation(QRail::StationEngine::Station *station);
 };
 
 #endif // STATIONS_H
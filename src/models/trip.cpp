@@ -19,7 +19,18 @@
 Trip::Trip(const QList<QRail::RouterEngine::Transfer *> &trip,
            QObject *parent): QAbstractListModel(parent)
 {
-    m_trip = trip;
+    m_trip.reserve(trip.length());
+    foreach (QRail::RouterEngine::Transfer *transfer, trip) {
+        TripEntry entry;
+        entry.station = transfer->station()->name().value(QLocale::Language::English);
+        entry.time = transfer->time();
+        entry.timeText = transfer->time().toLocalTime().toString("hh:mm");
+        entry.platform = transfer->platform();
+        entry.delay = transfer->delay();
+        entry.isCanceled = transfer->isCanceled();
+        entry.isNormalPlatform = transfer->isNormalPlatform();
+        m_trip.append(entry);
+    }
 }
 
 QHash<int, QByteArray> Trip::roleNames() const
@@ -28,6 +39,7 @@ QHash<int, QByteArray> Trip::roleNames() const
     roles[URIRole] = "URI";
     roles[stationRole] = "station";
     roles[timeRole] = "time";
+    roles[timeTextRole] = "timeText";
     roles[delayRole] = "delay";
     roles[isCanceled] = "isCanceled";
     roles[vehicleURIRole] = "vehicleURI";
@@ -49,25 +61,28 @@ QVariant Trip::data(const QModelIndex &index, int role) const
         return QVariant();
     }
     // Break not needed since return makes the rest unreachable.
+    const TripEntry &entry = m_trip.at(index.row());
     switch (role) {
     case URIRole:
         return QVariant(QString("http://example.com"));
     case stationRole:
-        return QVariant(m_trip.at(index.row())->station()->name().value(QLocale::Language::English));
+        return QVariant(entry.station);
     case timeRole:
-        return QVariant(m_trip.at(index.row())->time());
+        return QVariant(entry.time);
+    case timeTextRole:
+        return QVariant(entry.timeText);
     case delayRole:
-        return QVariant(m_trip.at(index.row())->delay());
+        return QVariant(entry.delay);
     case vehicleURIRole:
         return QVariant(QString("http://irail.be/vehicle/IC1234"));
     case vehicleHeadsignRole:
         return QVariant(QString("N/A"));
     case isCanceled:
-        return QVariant(m_trip.at(index.row())->isCanceled());
+        return QVariant(entry.isCanceled);
     case platformRole:
-        return QVariant(m_trip.at(index.row())->platform());
+        return QVariant(entry.platform);
     case isNormalPlatformRole:
-        return QVariant(m_trip.at(index.row())->isNormalPlatform());
+        return QVariant(entry.isNormalPlatform);
     // Expose more stuff from QRail: TO DO
     // arrival platform, time between, rest of N/A, ...
     default:
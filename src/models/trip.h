@@ -19,6 +19,8 @@
 
 #include <QtCore/QAbstractListModel>
 #include <QtCore/QList>
+#include <QtCore/QVector>
+#include <QtCore/QDateTime>
 #include <QtCore/QObject>
 #include <QtCore/QUrl>
 #include <QtCore/QVariant>
@@ -29,6 +31,18 @@
 
 #include "engines/router/routertransfer.h"
 
+// Flat copy of everything a trip delegate shows, built once when the Trip is created
+struct TripEntry {
+    QString station;
+    QDateTime time;
+    QString timeText;
+    QString platform;
+    qint32 delay;
+    bool isCanceled;
+    bool isNormalPlatform;
+};
+Q_DECLARE_TYPEINFO(TripEntry, Q_MOVABLE_TYPE);
+
 class Trip : public QAbstractListModel
 {
 public:
@@ -42,7 +56,8 @@ public:
         vehicleHeadsignRole = Qt::UserRole + 7,
         platformRole = Qt::UserRole + 8,
         isNormalPlatformRole = Qt::UserRole + 9,
-        isPassed = Qt::UserRole + 10
+        isPassed = Qt::UserRole + 10,
+        timeTextRole = Qt::UserRole + 11
     };
     explicit Trip(const QList<QRail::RouterEngine::Transfer *> &trip,
                   QObject *parent = nullptr);
@@ -53,7 +68,7 @@ protected:
     QHash<int, QByteArray> roleNames() const override;
 
 private:
-    QList<QRail::RouterEngine::Transfer *> m_trip;
+    QVector<TripEntry> m_trip;
 };
 
 #endif // TRIP_H
@@ -0,0 +1,318 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "connectionpage.h"
+
+UriTable *UriTable::m_instance = nullptr;
+
+UriTable::UriTable()
+{
+    // ID 0 is reserved for unknown URIs
+    m_uris.append(QString());
+}
+
+UriTable *UriTable::getInstance()
+{
+    if (m_instance == nullptr) {
+        lcDebug(lcNetwork) << "Creating new UriTable";
+        m_instance = new UriTable();
+    }
+    return m_instance;
+}
+
+quint32 UriTable::intern(const QString &uri)
+{
+    if (uri.isEmpty()) {
+        return 0;
+    }
+    const quint32 id = this->find(uri);
+    if (id) {
+        return id;
+    }
+    QWriteLocker locker(&m_lock);
+    if (m_ids.contains(uri)) {
+        return m_ids.value(uri);
+    }
+    m_uris.append(uri);
+    m_ids.insert(uri, m_uris.length() - 1);
+    return m_uris.length() - 1;
+}
+
+quint32 UriTable::find(const QString &uri) const
+{
+    QReadLocker locker(&m_lock);
+    return m_ids.value(uri, 0);
+}
+
+QString UriTable::uri(const quint32 &id) const
+{
+    QReadLocker locker(&m_lock);
+    return id < quint32(m_uris.length()) ? m_uris.at(id) : QString();
+}
+
+// Realtime events prefix the Linked Connections terms, pages don't
+static QJsonValue valueOf(const QJsonObject &connection, const QString &key)
+{
+    return connection.contains(key) ? connection.value(key) : connection.value("lc:" + key);
+}
+
+static QString uriOf(const QJsonValue &value)
+{
+    return value.isObject() ? value.toObject().value("@id").toString() : value.toString();
+}
+
+static qint64 msecsOf(const QJsonValue &value)
+{
+    const QDateTime time = QDateTime::fromString(value.toString(), Qt::ISODate);
+    return time.isValid() ? time.toMSecsSinceEpoch() : 0;
+}
+
+static qint16 packDelay(const QJsonValue &delay)
+{
+    return qint16(qBound(qint32(SHRT_MIN), delay.toInt(), qint32(SHRT_MAX)));
+}
+
+ConnectionPage::ConnectionPage()
+{
+    m_start = 0;
+}
+
+ConnectionPage ConnectionPage::fromJsonLd(const QByteArray &data, bool *ok)
+{
+    // A page or realtime update with a @graph, a list of connections or a single connection
+    ConnectionPage page;
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(data, &error);
+    QJsonArray graph;
+    if (document.isArray()) {
+        graph = document.array();
+    }
+    else if (document.object().contains("@graph")) {
+        graph = document.object().value("@graph").toArray();
+    }
+    else if (valueOf(document.object(), "departureTime").isString()) {
+        graph.append(document.object());
+    }
+    if (error.error != QJsonParseError::NoError || graph.isEmpty()) {
+        if (ok) {
+            *ok = false;
+        }
+        return page;
+    }
+
+    // Connections with a departure time, in departure order
+    QVector<QJsonObject> connections;
+    QVector<qint64> departures;
+    connections.reserve(graph.count());
+    departures.reserve(graph.count());
+    foreach (const QJsonValue &value, graph) {
+        const QJsonObject connection = value.toObject();
+        const qint64 departure = msecsOf(valueOf(connection, "departureTime"));
+        if (departure > 0) {
+            connections.append(connection);
+            departures.append(departure);
+        }
+    }
+    QVector<qint32> order(connections.length());
+    for (qint32 i = 0; i < order.length(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&departures](qint32 a, qint32 b) {
+        return departures.at(a) < departures.at(b);
+    });
+
+    // The page starts at its departureTime, the first departure is used when it's missing
+    const QDateTime start = QDateTime::fromString(QUrlQuery(QUrl(document.object().value("@id").toString()))
+                                                  .queryItemValue("departureTime"), Qt::ISODate);
+    page.m_start = start.isValid() ? start.toMSecsSinceEpoch() : (order.isEmpty() ? 0 : departures.at(order.first()));
+
+    UriTable *uris = UriTable::getInstance();
+    const qint32 count = order.length();
+    page.m_departureStop.reserve(count);
+    page.m_arrivalStop.reserve(count);
+    page.m_trip.reserve(count);
+    page.m_departureTime.reserve(count);
+    page.m_arrivalTime.reserve(count);
+    page.m_departureDelay.reserve(count);
+    page.m_arrivalDelay.reserve(count);
+    page.m_flags.reserve(count);
+    foreach (qint32 i, order) {
+        const QJsonObject &connection = connections.at(i);
+        quint8 flags = 0;
+        if (valueOf(connection, "departureCanceled").toBool()) {
+            flags |= DepartureCanceled;
+        }
+        if (valueOf(connection, "arrivalCanceled").toBool()) {
+            flags |= ArrivalCanceled;
+        }
+        if (uriOf(connection.value("gtfs:pickupType")) == "gtfs:NotAvailable") {
+            flags |= NoPickup;
+        }
+        if (uriOf(connection.value("gtfs:dropOffType")) == "gtfs:NotAvailable") {
+            flags |= NoDropOff;
+        }
+        const qint64 arrival = msecsOf(valueOf(connection, "arrivalTime"));
+        page.m_departureStop.append(uris->intern(uriOf(valueOf(connection, "departureStop"))));
+        page.m_arrivalStop.append(uris->intern(uriOf(valueOf(connection, "arrivalStop"))));
+        page.m_trip.append(uris->intern(uriOf(connection.value("gtfs:trip"))));
+        page.m_departureTime.append(qint32((departures.at(i) - page.m_start) / 1000));
+        page.m_arrivalTime.append(arrival > 0 ? qint32((arrival - page.m_start) / 1000)
+                                              : page.m_departureTime.last());
+        page.m_departureDelay.append(packDelay(valueOf(connection, "departureDelay")));
+        page.m_arrivalDelay.append(packDelay(valueOf(connection, "arrivalDelay")));
+        page.m_flags.append(flags);
+    }
+
+    if (ok) {
+        *ok = true;
+    }
+    return page;
+}
+
+QByteArray ConnectionPage::serialize() const
+{
+    // IDs are only valid in this process, the page carries its own URI table
+    QHash<quint32, quint32> local;
+    QVector<QString> strings;
+    UriTable *uris = UriTable::getInstance();
+    const QVector<quint32> *columns[] = { &m_departureStop, &m_arrivalStop, &m_trip };
+    for (const QVector<quint32> *column : columns) {
+        foreach (quint32 id, *column) {
+            if (!local.contains(id)) {
+                local.insert(id, strings.length());
+                strings.append(uris->uri(id));
+            }
+        }
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint32(CONNECTION_PAGE_MAGIC) << quint32(CONNECTION_PAGE_VERSION) << m_start << strings;
+    stream << quint32(this->count());
+    for (const QVector<quint32> *column : columns) {
+        foreach (quint32 id, *column) {
+            stream << local.value(id);
+        }
+    }
+    stream << m_departureTime << m_arrivalTime << m_departureDelay << m_arrivalDelay << m_flags;
+    return data;
+}
+
+ConnectionPage ConnectionPage::deserialize(const QByteArray &data, bool *ok)
+{
+    ConnectionPage page;
+    QDataStream stream(data);
+    quint32 magic = 0;
+    quint32 version = 0;
+    QVector<QString> strings;
+    quint32 count = 0;
+    stream >> magic >> version;
+    if (magic != CONNECTION_PAGE_MAGIC || version != CONNECTION_PAGE_VERSION) {
+        if (ok) {
+            *ok = false;
+        }
+        return ConnectionPage();
+    }
+    stream >> page.m_start >> strings >> count;
+
+    // Map the page's URI table onto the process wide IDs
+    QVector<quint32> ids;
+    ids.reserve(strings.length());
+    UriTable *uris = UriTable::getInstance();
+    foreach (const QString &uri, strings) {
+        ids.append(uris->intern(uri));
+    }
+    QVector<quint32> *columns[] = { &page.m_departureStop, &page.m_arrivalStop, &page.m_trip };
+    for (QVector<quint32> *column : columns) {
+        column->resize(count);
+        for (quint32 i = 0; i < count; i++) {
+            quint32 index = 0;
+            stream >> index;
+            (*column)[i] = index < quint32(ids.length()) ? ids.at(index) : 0;
+        }
+    }
+    stream >> page.m_departureTime >> page.m_arrivalTime >> page.m_departureDelay >> page.m_arrivalDelay >> page.m_flags;
+
+    const bool valid = stream.status() == QDataStream::Ok && quint32(page.m_flags.length()) == count
+            && quint32(page.m_departureTime.length()) == count && quint32(page.m_arrivalTime.length()) == count;
+    if (ok) {
+        *ok = valid;
+    }
+    return valid ? page : ConnectionPage();
+}
+
+bool ConnectionPage::isEmpty() const
+{
+    return m_departureTime.isEmpty();
+}
+
+qint32 ConnectionPage::count() const
+{
+    return m_departureTime.length();
+}
+
+qint64 ConnectionPage::timeOf(const qint32 &offset) const
+{
+    return m_start + 1000 * qint64(offset);
+}
+
+qint64 ConnectionPage::from() const
+{
+    return this->isEmpty() ? 0 : this->timeOf(m_departureTime.first());
+}
+
+qint64 ConnectionPage::until() const
+{
+    return this->isEmpty() ? 0 : this->timeOf(m_departureTime.last());
+}
+
+QSet<quint32> ConnectionPage::trips() const
+{
+    QSet<quint32> trips;
+    foreach (quint32 trip, m_trip) {
+        if (trip) {
+            trips.insert(trip);
+        }
+    }
+    return trips;
+}
+
+bool ConnectionPage::hasTrip(const QSet<quint32> &trips) const
+{
+    foreach (quint32 trip, m_trip) {
+        if (trips.contains(trip)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ConnectionPage::servesStop(const quint32 &stop, const qint64 &from, const qint64 &until) const
+{
+    // Departing from or arriving in the stop between from and until (ms since epoch)
+    if (stop == 0) {
+        return false;
+    }
+    for (qint32 i = 0; i < this->count(); i++) {
+        if ((m_departureStop.at(i) == stop && this->timeOf(m_departureTime.at(i)) >= from
+             && this->timeOf(m_departureTime.at(i)) <= until)
+                || (m_arrivalStop.at(i) == stop && this->timeOf(m_arrivalTime.at(i)) >= from
+                    && this->timeOf(m_arrivalTime.at(i)) <= until)) {
+            return true;
+        }
+    }
+    return false;
+}
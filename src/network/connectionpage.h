@@ -0,0 +1,97 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CONNECTIONPAGE_H
+#define CONNECTIONPAGE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMetaType>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QUrl>
+#include <QtCore/QUrlQuery>
+#include <QtCore/QVector>
+#include <algorithm>
+#include <climits>
+
+#include "../logging.h"
+
+#define CONNECTION_PAGE_MAGIC 0x4c435047 // "LCPG"
+#define CONNECTION_PAGE_VERSION 2
+
+// Process wide URI interning, station and trip URIs become 32-bit IDs
+class UriTable
+{
+public:
+    static UriTable *getInstance();
+    quint32 intern(const QString &uri);
+    quint32 find(const QString &uri) const; // 0 when the URI was never interned
+    QString uri(const quint32 &id) const;
+
+private:
+    UriTable();
+    static UriTable *m_instance;
+    mutable QReadWriteLock m_lock;
+    QHash<QString, quint32> m_ids;
+    QVector<QString> m_uris;
+};
+
+// Parsed Linked Connections page or realtime update stored as columns, one row per connection.
+// Times are offsets in seconds from the page start, rows are sorted by departure time.
+class ConnectionPage
+{
+public:
+    enum Flag {
+        DepartureCanceled = 0x01,
+        ArrivalCanceled = 0x02,
+        NoPickup = 0x04,
+        NoDropOff = 0x08
+    };
+    ConnectionPage();
+    static ConnectionPage fromJsonLd(const QByteArray &data, bool *ok = nullptr);
+    static ConnectionPage deserialize(const QByteArray &data, bool *ok = nullptr);
+    QByteArray serialize() const;
+    bool isEmpty() const;
+    qint32 count() const;
+    qint64 from() const; // first departure in ms since epoch
+    qint64 until() const; // last departure in ms since epoch
+    QSet<quint32> trips() const;
+    bool hasTrip(const QSet<quint32> &trips) const;
+    bool servesStop(const quint32 &stop, const qint64 &from, const qint64 &until) const;
+
+private:
+    qint64 m_start; // ms since epoch
+    QVector<quint32> m_departureStop;
+    QVector<quint32> m_arrivalStop;
+    QVector<quint32> m_trip;
+    QVector<qint32> m_departureTime; // s after m_start
+    QVector<qint32> m_arrivalTime; // s after m_start
+    QVector<qint16> m_departureDelay; // s
+    QVector<qint16> m_arrivalDelay; // s
+    QVector<quint8> m_flags;
+    qint64 timeOf(const qint32 &offset) const;
+};
+
+Q_DECLARE_METATYPE(ConnectionPage)
+
+#endif // CONNECTIONPAGE_H
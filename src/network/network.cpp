@@ -0,0 +1,57 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "network.h"
+
+void initNetwork(const bool &pageCache)
+{
+    // Route all traffic, including QRail's, through the record/replay proxy when requested
+    const QByteArray proxy = qgetenv(LCRAIL_PROXY_VARIABLE);
+    if (!proxy.isEmpty()) {
+        const QUrl url = QUrl::fromUserInput(QString::fromUtf8(proxy));
+        if (url.isValid() && !url.host().isEmpty()) {
+            lcInfo(lcNetwork) << "Using fixture proxy:" << url.host() << url.port(8080);
+            QNetworkProxy::setApplicationProxy(QNetworkProxy(QNetworkProxy::HttpProxy, url.host(), url.port(8080)));
+        }
+        else {
+            lcWarning(lcNetwork) << "Invalid" << LCRAIL_PROXY_VARIABLE << "value:" << proxy;
+        }
+    }
+
+    // Linked Connections pages are kept on disk across queries and restarts,
+    // realtime updates invalidate the pages holding the updated trips.
+    PageCache *cache = PageCache::getInstance();
+    const QString cacheSwitch = QString::fromLatin1(qgetenv(LCRAIL_PAGE_CACHE_VARIABLE)).toLower();
+    cache->setEnabled(cacheSwitch.isEmpty() ? pageCache : cacheSwitch != "off");
+    lcInfo(lcNetwork) << "Page cache:" << (cache->isEnabled() ? "on" : "off");
+    // QRail's Manager doesn't expose its QNAM, it's a child QObject of the Manager.
+    // QNetworkAccessManager::setCache() takes ownership of the cache.
+    QNetworkAccessManager *QNAM = QRail::Network::Manager::getInstance()->findChild<QNetworkAccessManager *>();
+    if (QNAM) {
+        new TrafficMeter(QNAM);
+        if (cache->isEnabled()) {
+            QNAM->setCache(cache);
+        }
+    }
+    else {
+        lcWarning(lcNetwork) << "QRail network manager has no QNAM, engines fetch without the page cache and aren't metered";
+    }
+
+    // Realtime transport of the app, selected at runtime (LCRAIL_REALTIME), connects once something is watched.
+    // QRail's own transport doesn't tell which connections changed, its pages expire as the server says.
+    Realtime *realtime = Realtime::getInstance();
+    QObject::connect(realtime, SIGNAL(connectionsUpdated(ConnectionPage)), cache, SLOT(invalidate(ConnectionPage)));
+}
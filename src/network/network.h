@@ -0,0 +1,38 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QUrl>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkProxy>
+
+#include "network/networkmanager.h"
+#include "engines/liveboard/liveboardfactory.h"
+#include "engines/router/routerplanner.h"
+#include "pagecache.h"
+#include "realtime.h"
+#include "trafficmeter.h"
+#include "../logging.h"
+
+// Environment variable with the URL of the record/replay proxy (benchmark/fixtures.py)
+#define LCRAIL_PROXY_VARIABLE "LCRAIL_PROXY"
+
+void initNetwork(const bool &pageCache = true); // LCRAIL_PAGE_CACHE overrides the default
+
+#endif // NETWORK_H
@@ -0,0 +1,501 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pagecache.h"
+
+PageCache *PageCache::m_instance = nullptr;
+
+PageCache::PageCache(QObject *parent) : QAbstractNetworkCache(parent)
+{
+    // The file is opened on first use, the application name is needed for the cache location
+    m_map = nullptr;
+    m_header = nullptr;
+    m_records = nullptr;
+    m_blocks = nullptr;
+    m_enabled = true;
+    m_hits = Metrics::getInstance()->counter("page_cache_hits");
+    m_misses = Metrics::getInstance()->counter("page_cache_misses");
+    m_prefetchHits = Metrics::getInstance()->counter("prefetch_hits");
+}
+
+PageCache::~PageCache()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+    }
+}
+
+PageCache *PageCache::getInstance()
+{
+    if (m_instance == nullptr) {
+        lcDebug(lcNetwork) << "Creating new PageCache";
+        m_instance = new PageCache();
+    }
+    return m_instance;
+}
+
+bool PageCache::isEnabled() const
+{
+    return m_enabled;
+}
+
+void PageCache::setEnabled(const bool &enabled)
+{
+    // Disabled: every lookup misses and nothing is written, the file isn't touched
+    m_enabled = enabled;
+}
+
+bool PageCache::open()
+{
+    if (!m_enabled) {
+        return false;
+    }
+    if (m_map) {
+        return true;
+    }
+
+    const QString location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QDir().mkpath(location);
+    m_file.setFileName(location + "/" + PAGE_CACHE_FILE);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        lcWarning(lcNetwork) << "Unable to open page cache:" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+
+    const bool existing = m_file.size() == PAGE_CACHE_SIZE;
+    if (!existing && !m_file.resize(PAGE_CACHE_SIZE)) {
+        lcWarning(lcNetwork) << "Unable to allocate page cache:" << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+    m_map = m_file.map(0, PAGE_CACHE_SIZE);
+    if (!m_map) {
+        lcWarning(lcNetwork) << "Unable to map page cache:" << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    // Layout: header, fixed record table, data blocks aligned to the block size
+    const qint64 recordsEnd = sizeof(Header) + PAGE_CACHE_MAX_ENTRIES * sizeof(Record);
+    const qint64 dataOffset = ((recordsEnd + PAGE_CACHE_BLOCK_SIZE - 1) / PAGE_CACHE_BLOCK_SIZE) * PAGE_CACHE_BLOCK_SIZE;
+    m_header = reinterpret_cast<Header *>(m_map);
+    m_records = reinterpret_cast<Record *>(m_map + sizeof(Header));
+    m_blocks = m_map + dataOffset;
+    const quint32 blockCount = (PAGE_CACHE_SIZE - dataOffset) / PAGE_CACHE_BLOCK_SIZE;
+
+    // Pages from a previous run are reused when the layout didn't change
+    if (!existing
+            || qstrncmp(m_header->magic, PAGE_CACHE_MAGIC, sizeof(m_header->magic)) != 0
+            || m_header->version != PAGE_CACHE_VERSION
+            || m_header->blockSize != PAGE_CACHE_BLOCK_SIZE
+            || m_header->maxEntries != PAGE_CACHE_MAX_ENTRIES
+            || m_header->blockCount != blockCount
+            || m_header->fileSize != PAGE_CACHE_SIZE) {
+        memcpy(m_header->magic, PAGE_CACHE_MAGIC, sizeof(m_header->magic));
+        m_header->version = PAGE_CACHE_VERSION;
+        m_header->blockSize = PAGE_CACHE_BLOCK_SIZE;
+        m_header->maxEntries = PAGE_CACHE_MAX_ENTRIES;
+        m_header->blockCount = blockCount;
+        m_header->fileSize = PAGE_CACHE_SIZE;
+        memset(m_records, 0, PAGE_CACHE_MAX_ENTRIES * sizeof(Record));
+    }
+    this->initialize();
+    lcInfo(lcNetwork) << "Page cache opened:" << m_index.count() << "pages";
+    return true;
+}
+
+void PageCache::initialize()
+{
+    // Rebuild the in-memory index and block map from the record table
+    m_index.clear();
+    m_blockOwners.fill(-1, m_header->blockCount);
+    for (qint32 r = 0; r < PAGE_CACHE_MAX_ENTRIES; r++) {
+        Record &record = m_records[r];
+        if (!record.valid) {
+            continue;
+        }
+        if (record.firstBlock + record.blockCount > m_header->blockCount || m_index.contains(record.key)) {
+            record.valid = 0; // Damaged, for example after a crash during a write
+            continue;
+        }
+        m_index.insert(record.key, r);
+        for (quint32 b = record.firstBlock; b < record.firstBlock + record.blockCount; b++) {
+            m_blockOwners[b] = r;
+        }
+    }
+}
+
+QUrl PageCache::normalize(const QUrl &url)
+{
+    // Query items in a fixed order, a page is identified by its URL and departureTime
+    QUrlQuery query(url);
+    QList<QPair<QString, QString> > items = query.queryItems(QUrl::FullyEncoded);
+    std::sort(items.begin(), items.end());
+    query.setQueryItems(items);
+    QUrl normalized = url.adjusted(QUrl::RemoveFragment);
+    normalized.setQuery(query);
+    return normalized;
+}
+
+quint64 PageCache::keyOf(const QUrl &url)
+{
+    const QByteArray hash = QCryptographicHash::hash(PageCache::normalize(url).toEncoded(), QCryptographicHash::Sha1);
+    quint64 key = 0;
+    memcpy(&key, hash.constData(), sizeof(key));
+    return key;
+}
+
+qint32 PageCache::recordOf(const QUrl &url) const
+{
+    return m_index.value(PageCache::keyOf(url), -1);
+}
+
+bool PageCache::read(const qint32 &record, QNetworkCacheMetaData &metaData, QByteArray *body, QByteArray *columns)
+{
+    // Pages are read straight from the mapping, the kernel loads them on demand
+    Record &entry = m_records[record];
+    const QByteArray serialized = QByteArray::fromRawData(reinterpret_cast<const char *>(m_blocks)
+                                                         + qint64(entry.firstBlock) * PAGE_CACHE_BLOCK_SIZE,
+                                                         entry.length);
+    QDataStream stream(serialized);
+    QUrl url;
+    stream >> url >> metaData;
+    if (body) {
+        stream >> *body;
+    }
+    else if (columns) {
+        // Skip the body without copying it: length prefix and raw bytes
+        quint32 length = 0;
+        stream >> length;
+        if (length != 0xFFFFFFFF) {
+            stream.skipRawData(length);
+        }
+    }
+    if (columns) {
+        stream >> *columns;
+    }
+    if (stream.status() != QDataStream::Ok || PageCache::keyOf(url) != entry.key) {
+        this->release(record);
+        return false;
+    }
+    entry.lastUsed = QDateTime::currentMSecsSinceEpoch();
+    return true;
+}
+
+bool PageCache::write(const QNetworkCacheMetaData &metaData, const QByteArray &body, const QByteArray &columns)
+{
+    QByteArray serialized;
+    QDataStream stream(&serialized, QIODevice::WriteOnly);
+    stream << PageCache::normalize(metaData.url()) << metaData << body << columns;
+    const quint32 blocks = (serialized.length() + PAGE_CACHE_BLOCK_SIZE - 1) / PAGE_CACHE_BLOCK_SIZE;
+    if (blocks == 0 || blocks > m_header->blockCount / 4) {
+        return false; // Too large to be worth caching
+    }
+
+    // Replace the previous version of the page
+    const quint64 key = PageCache::keyOf(metaData.url());
+    if (m_index.contains(key)) {
+        this->release(m_index.value(key));
+    }
+
+    const qint32 firstBlock = this->allocate(blocks);
+    if (firstBlock < 0) {
+        return false;
+    }
+    qint32 r = 0;
+    while (r < PAGE_CACHE_MAX_ENTRIES && m_records[r].valid) {
+        r++;
+    }
+    if (r == PAGE_CACHE_MAX_ENTRIES) {
+        return false; // allocate() keeps a free record around
+    }
+
+    // Data first, the record is only marked valid when the page is complete
+    memcpy(m_blocks + qint64(firstBlock) * PAGE_CACHE_BLOCK_SIZE, serialized.constData(), serialized.length());
+    Record &record = m_records[r];
+    record.key = key;
+    record.lastUsed = QDateTime::currentMSecsSinceEpoch();
+    record.expires = metaData.expirationDate().isValid() ? metaData.expirationDate().toMSecsSinceEpoch() : 0;
+    record.departure = departureOfPage(metaData.url());
+    record.until = departureOfPage(nextPageOf(body));
+    record.firstBlock = firstBlock;
+    record.blockCount = blocks;
+    record.length = serialized.length();
+    record.valid = 1;
+    m_index.insert(key, r);
+    for (quint32 b = record.firstBlock; b < record.firstBlock + record.blockCount; b++) {
+        m_blockOwners[b] = r;
+    }
+    return true;
+}
+
+qint32 PageCache::allocate(const quint32 &blocks)
+{
+    forever {
+        // First fit, as long as a record is free too
+        if (m_index.count() < PAGE_CACHE_MAX_ENTRIES) {
+            quint32 run = 0;
+            for (qint32 b = 0; b < m_blockOwners.length(); b++) {
+                run = m_blockOwners.at(b) < 0 ? run + 1 : 0;
+                if (run == blocks) {
+                    return b - blocks + 1;
+                }
+            }
+        }
+
+        // Evict expired pages first, afterwards the least recently used one
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        qint32 victim = -1;
+        foreach (qint32 r, m_index) {
+            const Record &record = m_records[r];
+            if (victim < 0) {
+                victim = r;
+                continue;
+            }
+            const Record &current = m_records[victim];
+            const bool expired = record.expires > 0 && record.expires < now;
+            const bool currentExpired = current.expires > 0 && current.expires < now;
+            if (expired != currentExpired ? expired : record.lastUsed < current.lastUsed) {
+                victim = r;
+            }
+        }
+        if (victim < 0) {
+            return -1;
+        }
+        this->release(victim);
+    }
+}
+
+void PageCache::release(const qint32 &record)
+{
+    Record &entry = m_records[record];
+    if (!entry.valid) {
+        return;
+    }
+    entry.valid = 0;
+    m_index.remove(entry.key);
+    m_prefetched.remove(entry.key);
+    for (quint32 b = entry.firstBlock; b < entry.firstBlock + entry.blockCount; b++) {
+        m_blockOwners[b] = -1;
+    }
+}
+
+QNetworkCacheMetaData PageCache::metaData(const QUrl &url)
+{
+    const QNetworkCacheMetaData metaData = this->cachedMetaData(url);
+    if (!metaData.isValid()) {
+        m_misses->add();
+        return metaData;
+    }
+    m_hits->add();
+    if (m_prefetched.remove(PageCache::keyOf(url))) {
+        m_prefetchHits->add();
+    }
+    return metaData;
+}
+
+QNetworkCacheMetaData PageCache::cachedMetaData(const QUrl &url)
+{
+    // Lookup without counting, for the prefetcher
+    QNetworkCacheMetaData metaData;
+    const qint32 record = this->open() ? this->recordOf(url) : -1;
+    if (record < 0 || !this->read(record, metaData)) {
+        return QNetworkCacheMetaData();
+    }
+    return metaData;
+}
+
+bool PageCache::isFresh(const QUrl &url)
+{
+    // Pages without an expiration date are revalidated by QNetworkAccessManager, not fresh
+    const QNetworkCacheMetaData metaData = this->cachedMetaData(url);
+    return metaData.isValid() && metaData.expirationDate().isValid()
+            && metaData.expirationDate() > QDateTime::currentDateTimeUtc();
+}
+
+bool PageCache::store(QNetworkReply *reply, const QByteArray &body, const bool &prefetched)
+{
+    // Same metadata QNetworkAccessManager stores for a reply, so it can use the page later
+    QNetworkCacheMetaData metaData;
+    metaData.setUrl(reply->request().url());
+    metaData.setRawHeaders(reply->rawHeaderPairs());
+    metaData.setLastModified(reply->header(QNetworkRequest::LastModifiedHeader).toDateTime());
+    const QString cacheControl = QString::fromLatin1(reply->rawHeader("Cache-Control")).toLower();
+    const QRegExp maxAge("max-age=(\\d+)");
+    if (maxAge.indexIn(cacheControl) >= 0) {
+        metaData.setExpirationDate(QDateTime::currentDateTimeUtc().addSecs(maxAge.cap(1).toLongLong()));
+    }
+    else if (reply->hasRawHeader("Expires")) {
+        // RFC 1123 date, for example: Sun, 31 Mar 2019 14:00:00 GMT
+        QDateTime expires = QLocale::c().toDateTime(QString::fromLatin1(reply->rawHeader("Expires")),
+                                                     "ddd, dd MMM yyyy hh:mm:ss 'GMT'");
+        expires.setTimeSpec(Qt::UTC);
+        metaData.setExpirationDate(expires);
+    }
+    // no-cache pages are stored, QNetworkAccessManager revalidates them before use
+    metaData.setSaveToDisk(!cacheControl.contains("no-store"));
+    QNetworkCacheMetaData::AttributesMap attributes;
+    attributes.insert(QNetworkRequest::HttpStatusCodeAttribute,
+                      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute));
+    attributes.insert(QNetworkRequest::HttpReasonPhraseAttribute,
+                      reply->attribute(QNetworkRequest::HttpReasonPhraseAttribute));
+    metaData.setAttributes(attributes);
+
+    QIODevice *device = this->prepare(metaData);
+    if (!device) {
+        return false;
+    }
+    device->write(body);
+    this->insert(device);
+    if (prefetched) {
+        m_prefetched.insert(PageCache::keyOf(metaData.url()));
+    }
+    return true;
+}
+
+void PageCache::updateMetaData(const QNetworkCacheMetaData &metaData)
+{
+    // Revalidated pages (304 Not Modified) get the new headers, the body is kept
+    QNetworkCacheMetaData previous;
+    QByteArray body;
+    QByteArray columns;
+    const qint32 record = this->open() ? this->recordOf(metaData.url()) : -1;
+    if (record >= 0 && this->read(record, previous, &body, &columns)) {
+        this->write(metaData, body, columns);
+    }
+}
+
+QIODevice *PageCache::data(const QUrl &url)
+{
+    QNetworkCacheMetaData metaData;
+    QByteArray body;
+    const qint32 record = this->open() ? this->recordOf(url) : -1;
+    if (record < 0 || !this->read(record, metaData, &body)) {
+        return nullptr;
+    }
+
+    // Caller takes ownership
+    QBuffer *buffer = new QBuffer();
+    buffer->setData(body);
+    buffer->open(QIODevice::ReadOnly);
+    return buffer;
+}
+
+bool PageCache::remove(const QUrl &url)
+{
+    // Aborted downloads are removed too
+    QHash<QIODevice *, QNetworkCacheMetaData>::iterator it = m_inserting.begin();
+    while (it != m_inserting.end()) {
+        if (it.value().url() == url) {
+            delete it.key();
+            it = m_inserting.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    const qint32 record = this->open() ? this->recordOf(url) : -1;
+    if (record < 0) {
+        return false;
+    }
+    this->release(record);
+    return true;
+}
+
+qint64 PageCache::cacheSize() const
+{
+    return PAGE_CACHE_SIZE;
+}
+
+QIODevice *PageCache::prepare(const QNetworkCacheMetaData &metaData)
+{
+    // Honor the server: no-store responses are never written
+    if (!metaData.isValid() || !metaData.url().isValid() || !metaData.saveToDisk() || !this->open()) {
+        return nullptr;
+    }
+
+    QBuffer *buffer = new QBuffer();
+    buffer->open(QIODevice::ReadWrite);
+    m_inserting.insert(buffer, metaData);
+    return buffer;
+}
+
+void PageCache::insert(QIODevice *device)
+{
+    if (!m_inserting.contains(device)) {
+        return;
+    }
+    const QNetworkCacheMetaData metaData = m_inserting.take(device);
+    QBuffer *buffer = qobject_cast<QBuffer *>(device);
+    if (buffer) {
+        // Linked Connections pages are parsed once here, other resources are stored as is
+        bool ok = false;
+        const ConnectionPage page = ConnectionPage::fromJsonLd(buffer->data(), &ok);
+        if (!this->write(metaData, buffer->data(), ok ? page.serialize() : QByteArray())) {
+            lcWarning(lcNetwork) << "Unable to cache page:" << metaData.url();
+        }
+    }
+    delete device;
+}
+
+void PageCache::clear()
+{
+    if (!this->open()) {
+        return;
+    }
+    for (qint32 r = 0; r < PAGE_CACHE_MAX_ENTRIES; r++) {
+        this->release(r);
+    }
+}
+
+void PageCache::invalidate(const ConnectionPage &update)
+{
+    // Only the pages around the updated departures which hold one of the updated trips changed,
+    // the others stay cached. Pages without columns can't be checked and are dropped.
+    if (!this->open() || update.isEmpty()) {
+        return;
+    }
+    const QSet<quint32> trips = update.trips();
+    QList<qint32> invalidated;
+    foreach (qint32 r, m_index) {
+        const Record &record = m_records[r];
+        if (record.departure == 0) {
+            continue; // Not a connections page
+        }
+        const qint64 end = record.until > record.departure ? record.until
+                                                           : record.departure + PAGE_CACHE_PAGE_SPAN * 1000;
+        if (record.departure > update.until() || end <= update.from()) {
+            continue;
+        }
+        QNetworkCacheMetaData metaData;
+        QByteArray columns;
+        bool ok = false;
+        const qint64 lastUsed = record.lastUsed;
+        if (!this->read(r, metaData, nullptr, &columns)) {
+            continue; // Damaged, read() released it
+        }
+        m_records[r].lastUsed = lastUsed; // Checking a page isn't using it
+        const ConnectionPage page = ConnectionPage::deserialize(columns, &ok);
+        if (!ok || trips.isEmpty() || page.hasTrip(trips)) {
+            invalidated.append(r);
+        }
+    }
+    foreach (qint32 r, invalidated) {
+        this->release(r);
+    }
+    lcDebug(lcNetwork) << "Realtime update invalidated" << invalidated.length() << "cached pages";
+}
@@ -0,0 +1,134 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <QtCore/QObject>
+#include <QtCore/QBuffer>
+#include <QtCore/QByteArray>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QLocale>
+#include <QtCore/QRegExp>
+#include <QtCore/QPair>
+#include <QtCore/QSet>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QUrl>
+#include <QtCore/QUrlQuery>
+#include <QtCore/QVector>
+#include <QtNetwork/QAbstractNetworkCache>
+#include <QtNetwork/QNetworkCacheMetaData>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+#include <algorithm>
+#include <cstring>
+
+#include "../metrics/metrics.h"
+#include "connectionpage.h"
+#include "server.h"
+#include "../logging.h"
+
+#define PAGE_CACHE_FILE "pages.cache"
+#define PAGE_CACHE_MAGIC "LCRAILPC"
+#define PAGE_CACHE_VERSION 5
+#define PAGE_CACHE_SIZE (32 * 1024 * 1024) // bytes, including the index
+#define PAGE_CACHE_BLOCK_SIZE (16 * 1024) // bytes
+#define PAGE_CACHE_MAX_ENTRIES 2048
+#define PAGE_CACHE_PAGE_SPAN 600 // seconds covered by a page without a next link
+#define LCRAIL_PAGE_CACHE_VARIABLE "LCRAIL_PAGE_CACHE" // on or off
+
+// Persistent cache for QNetworkAccessManager, backed by one memory-mapped file.
+// Pages are kept across restarts and evicted least recently used first when the file is full.
+// Freshness is decided by QNetworkAccessManager from the cached server headers.
+// Linked Connections pages are parsed once when stored and their columns are kept next to the body,
+// realtime updates only invalidate the pages holding a connection of an updated trip.
+class PageCache : public QAbstractNetworkCache
+{
+    Q_OBJECT
+public:
+    static PageCache *getInstance();
+    bool isEnabled() const;
+    void setEnabled(const bool &enabled);
+    QNetworkCacheMetaData metaData(const QUrl &url) override;
+    void updateMetaData(const QNetworkCacheMetaData &metaData) override;
+    QIODevice *data(const QUrl &url) override;
+    bool remove(const QUrl &url) override;
+    qint64 cacheSize() const override;
+    QIODevice *prepare(const QNetworkCacheMetaData &metaData) override;
+    void insert(QIODevice *device) override;
+    QNetworkCacheMetaData cachedMetaData(const QUrl &url);
+    bool isFresh(const QUrl &url);
+    bool store(QNetworkReply *reply, const QByteArray &body, const bool &prefetched);
+    static quint64 keyOf(const QUrl &url);
+
+public slots:
+    void clear() override;
+    void invalidate(const ConnectionPage &update);
+
+private:
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 blockSize;
+        quint32 maxEntries;
+        quint32 blockCount;
+        qint64 fileSize;
+    };
+    struct Record {
+        quint64 key; // first 64 bits of the SHA1 of the normalized URL
+        qint64 lastUsed; // ms since epoch
+        qint64 expires; // ms since epoch, 0 when unknown
+        qint64 departure; // departureTime of the page in ms since epoch, 0 when unknown
+        qint64 until; // departureTime of the next page in ms since epoch, 0 when unknown
+        quint32 firstBlock;
+        quint32 blockCount;
+        quint32 length; // bytes of the serialized entry
+        quint32 valid;
+    };
+    explicit PageCache(QObject *parent = nullptr);
+    ~PageCache();
+    static PageCache *m_instance;
+    QFile m_file;
+    uchar *m_map;
+    Header *m_header;
+    Record *m_records;
+    uchar *m_blocks;
+    QVector<qint32> m_blockOwners; // block -> record, -1 when free
+    QHash<quint64, qint32> m_index; // key -> record
+    QHash<QIODevice *, QNetworkCacheMetaData> m_inserting;
+    QSet<quint64> m_prefetched; // prefetched pages which weren't requested yet
+    bool m_enabled;
+    Counter *m_hits;
+    Counter *m_misses;
+    Counter *m_prefetchHits;
+    bool open();
+    void initialize();
+    static QUrl normalize(const QUrl &url);
+    qint32 recordOf(const QUrl &url) const;
+    bool read(const qint32 &record, QNetworkCacheMetaData &metaData,
+              QByteArray *body = nullptr, QByteArray *columns = nullptr);
+    bool write(const QNetworkCacheMetaData &metaData, const QByteArray &body, const QByteArray &columns);
+    qint32 allocate(const quint32 &blocks);
+    void release(const qint32 &record);
+};
+
+#endif // PAGECACHE_H
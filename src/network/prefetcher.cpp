@@ -0,0 +1,280 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "prefetcher.h"
+
+QNetworkAccessManager *Prefetcher::m_QNAM = nullptr;
+
+static QByteArray locationOf(const QNetworkCacheMetaData &metaData)
+{
+    foreach (const QNetworkCacheMetaData::RawHeader &header, metaData.rawHeaders()) {
+        if (header.first.toLower() == "location") {
+            return header.second;
+        }
+    }
+    return QByteArray();
+}
+
+Prefetcher::Prefetcher(QObject *parent) : QObject(parent)
+{
+    // Pages are written to the page cache directly, a cache can't be shared between QNAMs.
+    // All prefetchers share one QNAM, requests to the same host reuse its kept-alive connections.
+    if (m_QNAM == nullptr) {
+        m_QNAM = new QNetworkAccessManager();
+    }
+    m_cache = PageCache::getInstance();
+
+    // Traffic and hit rate (prefetch_hits / prefetch_requests) on mobile data
+    Metrics *metrics = Metrics::getInstance();
+    m_requests = metrics->counter("prefetch_requests");
+    m_bytes = metrics->counter("prefetch_bytes");
+    m_skipped = metrics->counter("prefetch_skipped");
+
+    // Init variables
+    bool ok = false;
+    m_window = qgetenv(LCRAIL_FETCH_WINDOW_VARIABLE).toInt(&ok);
+    if (!ok || m_window < 1) {
+        m_window = PREFETCH_WINDOW;
+    }
+    m_from = 0;
+    m_until = 0;
+    m_consumed = 0;
+    m_speculated = 0;
+    m_span = PREFETCH_DEFAULT_SPAN;
+    m_frontierTime = 0;
+    m_pages = 0;
+    m_running = false;
+}
+
+void Prefetcher::prefetch(const QDateTime &from, const QDateTime &until)
+{
+    // Same window as the running prefetch, for example the query right after its prefetch
+    const qint64 start = from.toMSecsSinceEpoch();
+    const qint64 end = until.isValid() ? until.toMSecsSinceEpoch() : start + 1000 * PREFETCH_DEFAULT_WINDOW;
+    if (m_running && start >= m_from && end <= m_until) {
+        return;
+    }
+
+    // Warming a disabled cache only doubles the traffic
+    if (!m_cache->isEnabled()) {
+        return;
+    }
+
+    this->cancel();
+    lcDebug(lcNetwork) << "Prefetching pages:" << from << "->" << QDateTime::fromMSecsSinceEpoch(end) << "window:" << m_window;
+    m_running = true;
+    m_from = start;
+    m_until = end;
+    m_consumed = start;
+    m_speculated = start;
+    m_frontier = connectionsPageOf(from);
+    m_frontierTime = start;
+    m_pages = 0;
+    this->schedule();
+}
+
+void Prefetcher::cancel()
+{
+    this->stop();
+}
+
+void Prefetcher::stop()
+{
+    QHash<QNetworkReply *, Target> inFlight = m_inFlight;
+    m_inFlight.clear();
+    foreach (QNetworkReply *reply, inFlight.keys()) {
+        reply->abort();
+        reply->deleteLater();
+    }
+    m_running = false;
+}
+
+void Prefetcher::consumed(const QDateTime &departureTime)
+{
+    // The engine moved on, pages further ahead can be requested again
+    if (m_running && departureTime.isValid() && departureTime.toMSecsSinceEpoch() > m_consumed) {
+        m_consumed = departureTime.toMSecsSinceEpoch();
+        this->schedule();
+    }
+}
+
+bool Prefetcher::isRunning() const
+{
+    return m_running;
+}
+
+qint32 Prefetcher::window() const
+{
+    return m_window;
+}
+
+void Prefetcher::setWindow(const qint32 &window)
+{
+    m_window = qMax(1, window);
+    this->schedule();
+}
+
+void Prefetcher::schedule()
+{
+    if (!m_running) {
+        return;
+    }
+
+    // The chain is always followed first, fresh cached pages are skipped without a request
+    while (m_frontier.isValid() && !this->replyOf(m_frontier) && m_cache->isFresh(m_frontier)) {
+        const QByteArray location = locationOf(m_cache->cachedMetaData(m_frontier));
+        if (!location.isEmpty()) {
+            m_frontier = m_frontier.resolved(QUrl::fromEncoded(location));
+            continue;
+        }
+        QIODevice *device = m_cache->data(m_frontier);
+        const QByteArray body = device ? device->readAll() : QByteArray();
+        delete device;
+        m_skipped->add();
+        this->advance(m_frontier, body);
+        if (!m_running) {
+            return;
+        }
+    }
+    if (m_frontier.isValid()) {
+        // A speculative request may be fetching the next page of the chain already
+        QNetworkReply *reply = this->replyOf(m_frontier);
+        if (reply) {
+            m_inFlight[reply].chained = true;
+        }
+        else {
+            Target target = { true, 0 };
+            this->request(m_frontier, target);
+        }
+    }
+
+    // Speculative requests fill the window, limited by how far the engine is behind
+    const qint64 span = 1000 * m_span;
+    const qint64 ahead = qMin(m_until, m_consumed + PREFETCH_MAX_AHEAD * span);
+    m_speculated = qMax(m_speculated, m_frontierTime);
+    while (m_inFlight.count() < m_window
+           && m_pages + m_inFlight.count() < PREFETCH_MAX_PAGES
+           && m_speculated + span < ahead) {
+        m_speculated += span;
+        Target target = { false, 0 };
+        this->request(connectionsPageOf(QDateTime::fromMSecsSinceEpoch(m_speculated, Qt::UTC)), target);
+    }
+}
+
+QNetworkReply *Prefetcher::replyOf(const QUrl &url) const
+{
+    foreach (QNetworkReply *reply, m_inFlight.keys()) {
+        if (reply->request().url() == url) {
+            return reply;
+        }
+    }
+    return nullptr;
+}
+
+void Prefetcher::request(const QUrl &url, const Target &target)
+{
+    QNetworkRequest request(url);
+    request.setPriority(QNetworkRequest::LowPriority);
+    request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+    request.setRawHeader("Accept", "application/ld+json");
+    QNetworkReply *reply = m_QNAM->get(request);
+    connect(reply, SIGNAL(finished()), this, SLOT(handleFinished()));
+    m_inFlight.insert(reply, target);
+    m_requests->add();
+}
+
+void Prefetcher::handleFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!reply || !m_inFlight.contains(reply)) {
+        return; // Cancelled
+    }
+    Target target = m_inFlight.take(reply);
+    reply->deleteLater();
+    if (reply->error() != QNetworkReply::NoError) {
+        lcWarning(lcNetwork) << "Prefetching failed:" << reply->url() << reply->errorString();
+        if (target.chained) {
+            this->finish(); // The chain can't be completed anymore
+        }
+        else {
+            this->schedule();
+        }
+        return;
+    }
+
+    const QByteArray body = reply->readAll();
+    m_bytes->add(body.length());
+    m_cache->store(reply, body, true);
+
+    // departureTime URLs are redirected to the page which contains it
+    const QUrl redirect = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+    if (redirect.isValid()) {
+        const QUrl location = reply->url().resolved(redirect);
+        if (++target.redirects > PREFETCH_MAX_REDIRECTS) {
+            if (target.chained) {
+                this->finish();
+                return;
+            }
+        }
+        else if (target.chained) {
+            m_frontier = location; // Requested by schedule() when it isn't cached or in flight
+        }
+        else if (!this->replyOf(location) && !m_cache->isFresh(location)) {
+            this->request(location, target);
+        }
+        this->schedule();
+        return;
+    }
+
+    if (target.chained) {
+        this->advance(reply->request().url(), body);
+    }
+    this->schedule();
+}
+
+void Prefetcher::advance(const QUrl &page, const QByteArray &body)
+{
+    // The chain moves on to the next page, until the window is covered
+    const QUrl next = nextPageOf(body);
+    m_pages++;
+    if (!next.isValid()) {
+        this->finish();
+        return;
+    }
+
+    // Better estimate of the time span of a page for the speculative requests
+    const qint64 start = departureOfPage(page);
+    const qint64 end = departureOfPage(next);
+    if (start > 0 && end > start) {
+        m_span = (m_span + (end - start) / 1000) / 2;
+    }
+    m_frontier = next;
+    m_frontierTime = qMax(m_frontierTime, end);
+
+    if (m_frontierTime >= m_until || m_pages >= PREFETCH_MAX_PAGES) {
+        this->finish();
+    }
+}
+
+void Prefetcher::finish()
+{
+    if (!m_running) {
+        return;
+    }
+    lcDebug(lcNetwork) << "Prefetching finished:" << m_pages << "pages";
+    this->stop();
+    emit this->finished();
+}
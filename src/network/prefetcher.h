@@ -0,0 +1,96 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QUrl>
+#include <QtCore/QUrlQuery>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+
+#include "../metrics/metrics.h"
+#include "pagecache.h"
+#include "server.h"
+#include "../logging.h"
+
+#define LCRAIL_FETCH_WINDOW_VARIABLE "LCRAIL_FETCH_WINDOW"
+#define PREFETCH_WINDOW 4 // requests in flight
+#define PREFETCH_MAX_AHEAD 12 // pages ahead of the engine, backpressure when it falls behind
+#define PREFETCH_MAX_PAGES 40 // per prefetch, limits the mobile data spent on a guess
+#define PREFETCH_MAX_REDIRECTS 5
+#define PREFETCH_DEFAULT_SPAN 600 // seconds per page until the first page is known
+#define PREFETCH_DEFAULT_WINDOW 7200 // seconds after the departure time when no end is given
+
+// Warms the page cache for a departure window ahead of an engine, the engine
+// fetches the pages itself and finds them in the cache.
+// Up to window() requests are in flight: the next page of the hydra:next chain
+// and speculative departureTime requests further on.
+// Every model has its own prefetcher, one prefetch at a time. QML can create one
+// to warm the pages before a model exists, for example while a query is filled in.
+class Prefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Prefetcher(QObject *parent = nullptr);
+    Q_INVOKABLE void prefetch(const QDateTime &from, const QDateTime &until = QDateTime());
+    Q_INVOKABLE void cancel();
+    void consumed(const QDateTime &departureTime);
+    bool isRunning() const;
+    qint32 window() const;
+    void setWindow(const qint32 &window);
+
+signals:
+    void finished();
+
+private slots:
+    void handleFinished();
+
+private:
+    struct Target {
+        bool chained; // next link of the chain
+        qint32 redirects;
+    };
+    static QNetworkAccessManager *m_QNAM;
+    PageCache *m_cache;
+    QHash<QNetworkReply *, Target> m_inFlight;
+    qint64 m_from;
+    qint64 m_until;
+    qint64 m_consumed; // departure time of the page the engine is processing
+    qint64 m_speculated; // furthest departureTime requested speculatively
+    qint64 m_span; // estimated seconds per page
+    QUrl m_frontier; // next page of the chain
+    qint64 m_frontierTime;
+    qint32 m_window;
+    qint32 m_pages;
+    bool m_running;
+    Counter *m_requests;
+    Counter *m_bytes;
+    Counter *m_skipped;
+    void schedule();
+    void request(const QUrl &url, const Target &target);
+    QNetworkReply *replyOf(const QUrl &url) const;
+    void advance(const QUrl &page, const QByteArray &body);
+    void stop();
+    void finish();
+};
+
+#endif // PREFETCHER_H
@@ -0,0 +1,333 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "realtime.h"
+
+Realtime *Realtime::m_instance = nullptr;
+
+Realtime::Realtime(QObject *parent) : QObject(parent)
+{
+    // Own QNAM: realtime resources must never come from the page cache
+    m_QNAM = new QNetworkAccessManager(this);
+    m_configurations = new QNetworkConfigurationManager(this);
+    connect(m_configurations, SIGNAL(onlineStateChanged(bool)), this, SLOT(evaluate()));
+    connect(m_configurations, SIGNAL(configurationChanged(QNetworkConfiguration)), this, SLOT(evaluate()));
+
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setSingleShot(true);
+    connect(m_pollTimer, SIGNAL(timeout()), this, SLOT(poll()));
+    m_evaluateTimer = new QTimer(this);
+    m_evaluateTimer->setInterval(REALTIME_EVALUATE_INTERVAL);
+    connect(m_evaluateTimer, SIGNAL(timeout()), this, SLOT(evaluate()));
+
+    // Bytes per mode and the mode itself (0 off, 1 polling, 2 streaming) for the benchmarks
+    Metrics *metrics = Metrics::getInstance();
+    m_bytes = metrics->counter("realtime_bytes");
+    m_updateCount = metrics->counter("realtime_updates");
+    m_notModified = metrics->counter("realtime_not_modified");
+    m_modeGauge = metrics->gauge("realtime_mode");
+    qRegisterMetaType<ConnectionPage>();
+
+    // Init variables
+    m_reply = nullptr;
+    m_mode = Off;
+    m_requestedMode = Off;
+    m_pollInterval = REALTIME_POLL_MIN;
+    m_reconnectInterval = REALTIME_POLL_MIN;
+    m_updates = 0;
+    m_selection = QString::fromLatin1(qgetenv(LCRAIL_REALTIME_VARIABLE)).toLower();
+    if (m_selection.isEmpty()) {
+        m_selection = "auto";
+    }
+    m_automatic = m_selection == "auto";
+    if (m_selection == "poll") {
+        m_requestedMode = Polling;
+    }
+    else if (m_selection == "sse") {
+        m_requestedMode = Streaming;
+    }
+    else if (!m_automatic && m_selection != "qrail" && m_selection != "off") {
+        lcWarning(lcNetwork) << "Invalid" << LCRAIL_REALTIME_VARIABLE << "value:" << m_selection;
+        m_selection = "off";
+    }
+    lcInfo(lcNetwork) << "Realtime transport:" << m_selection;
+}
+
+Realtime *Realtime::getInstance()
+{
+    if (m_instance == nullptr) {
+        lcDebug(lcNetwork) << "Creating new Realtime";
+        m_instance = new Realtime();
+    }
+    return m_instance;
+}
+
+Realtime::Mode Realtime::mode() const
+{
+    return m_mode;
+}
+
+QString Realtime::selection() const
+{
+    return m_selection;
+}
+
+bool Realtime::usesQRailTransport() const
+{
+    return m_selection == "qrail";
+}
+
+void Realtime::setWatching(QObject *watcher, const bool &watching)
+{
+    // Connected as long as any board or journey is watched, nothing to update otherwise
+    const bool wasActive = !m_watchers.isEmpty();
+    if (watching) {
+        m_watchers.insert(watcher);
+    }
+    else {
+        m_watchers.remove(watcher);
+    }
+    const bool active = !m_watchers.isEmpty();
+    if (active == wasActive || this->usesQRailTransport()) {
+        return;
+    }
+
+    if (!active) {
+        m_evaluateTimer->stop();
+        this->setMode(Off);
+        m_etag.clear();
+        m_lastModified.clear();
+        m_validator.clear(); // Watches fetched later are the new baseline
+    }
+    else if (m_automatic) {
+        m_evaluateTimer->start();
+        this->evaluate();
+    }
+    else {
+        this->setMode(m_requestedMode);
+    }
+}
+
+QString Realtime::modeName(const Mode &mode)
+{
+    switch (mode) {
+    case Polling:
+        return "polling";
+    case Streaming:
+        return "streaming";
+    default:
+        return "off";
+    }
+}
+
+bool Realtime::isCharging()
+{
+    // Any power supply which is charging or full means the device is plugged in
+    QDir supplies(POWER_SUPPLY_PATH);
+    foreach (const QString &supply, supplies.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFile status(supplies.filePath(supply + "/status"));
+        if (status.open(QIODevice::ReadOnly)) {
+            const QByteArray state = status.readAll().trimmed();
+            if (state == "Charging" || state == "Full") {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void Realtime::evaluate()
+{
+    const qint32 updates = m_updates;
+    m_updates = 0;
+    if (!m_automatic || m_watchers.isEmpty()) {
+        return;
+    }
+    if (!m_configurations->isOnline()) {
+        this->setMode(Off);
+        return;
+    }
+
+    // A stream keeps the radio awake, only worth it when it's cheap or updates are frequent
+    const QNetworkConfiguration::BearerType bearer = m_configurations->defaultConfiguration().bearerType();
+    const bool unmetered = bearer == QNetworkConfiguration::BearerWLAN || bearer == QNetworkConfiguration::BearerEthernet;
+    const qint32 rate = updates * 60000 / REALTIME_EVALUATE_INTERVAL;
+    this->setMode(unmetered || Realtime::isCharging() || rate > REALTIME_SSE_RATE ? Streaming : Polling);
+}
+
+void Realtime::setMode(const Mode &mode)
+{
+    if (m_mode == mode) {
+        return;
+    }
+    lcInfo(lcNetwork) << "Realtime mode:" << Realtime::modeName(m_mode) << "->" << Realtime::modeName(mode);
+    this->stop();
+    m_mode = mode;
+    m_modeGauge->set(mode);
+    if (mode == Polling) {
+        m_pollInterval = REALTIME_POLL_MIN;
+        this->poll();
+    }
+    else if (mode == Streaming) {
+        m_reconnectInterval = REALTIME_POLL_MIN;
+        this->stream();
+    }
+    emit this->modeChanged(mode);
+}
+
+void Realtime::stop()
+{
+    m_pollTimer->stop();
+    if (m_reply) {
+        QNetworkReply *reply = m_reply;
+        m_reply = nullptr;
+        reply->abort();
+        reply->deleteLater();
+    }
+    m_buffer.clear();
+}
+
+void Realtime::update(const QByteArray &events)
+{
+    m_updates++;
+    m_updateCount->add();
+
+    // Updated connections, the page cache only drops the pages holding their trips
+    const ConnectionPage update = ConnectionPage::fromJsonLd(events);
+    if (!update.isEmpty()) {
+        emit this->connectionsUpdated(update);
+    }
+    emit this->updateReceived(QDateTime::currentMSecsSinceEpoch());
+}
+
+void Realtime::poll()
+{
+    // Conditional GET, the server answers 304 without a body when nothing changed
+    QNetworkRequest request(serverResource(LC_EVENTS_RESOURCE));
+    request.setRawHeader("Accept", "application/ld+json");
+    if (!m_etag.isEmpty()) {
+        request.setRawHeader("If-None-Match", m_etag);
+    }
+    if (!m_lastModified.isEmpty()) {
+        request.setRawHeader("If-Modified-Since", m_lastModified);
+    }
+    m_reply = m_QNAM->get(request);
+    connect(m_reply, SIGNAL(finished()), this, SLOT(handlePollFinished()));
+}
+
+void Realtime::handlePollFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!reply || reply != m_reply) {
+        return; // Stopped
+    }
+    m_reply = nullptr;
+    reply->deleteLater();
+
+    const qint32 status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const QByteArray body = reply->readAll();
+    m_bytes->add(body.length());
+    if (reply->error() == QNetworkReply::NoError && status == 200) {
+        // Servers without validators answer 200 every time, the body tells whether anything changed
+        m_etag = reply->rawHeader("ETag");
+        m_lastModified = reply->rawHeader("Last-Modified");
+        const QByteArray validator = !m_etag.isEmpty() ? m_etag
+                                   : !m_lastModified.isEmpty() ? m_lastModified
+                                   : QCryptographicHash::hash(body, QCryptographicHash::Sha1);
+        const bool first = m_validator.isEmpty();
+        const bool changed = validator != m_validator;
+        m_validator = validator;
+
+        // The first response is the state the watches were fetched with, not an update.
+        // Changed: poll fast again, updates tend to come in bursts.
+        if (changed && !first) {
+            m_pollInterval = REALTIME_POLL_MIN;
+            this->update(body);
+        }
+        else if (!changed) {
+            m_pollInterval = qMin(2 * m_pollInterval, REALTIME_POLL_MAX);
+        }
+    }
+    else if (status == 304) {
+        m_notModified->add();
+        m_pollInterval = qMin(2 * m_pollInterval, REALTIME_POLL_MAX);
+    }
+    else {
+        lcWarning(lcNetwork) << "Realtime polling failed:" << reply->errorString();
+        m_pollInterval = qMin(2 * m_pollInterval, REALTIME_POLL_MAX);
+    }
+    m_pollTimer->start(m_pollInterval);
+}
+
+void Realtime::stream()
+{
+    QNetworkRequest request(serverResource(LC_EVENTS_SSE_RESOURCE));
+    request.setRawHeader("Accept", "text/event-stream");
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+    m_reply = m_QNAM->get(request);
+    connect(m_reply, SIGNAL(readyRead()), this, SLOT(handleStreamReadyRead()));
+    connect(m_reply, SIGNAL(finished()), this, SLOT(handleStreamFinished()));
+}
+
+void Realtime::handleStreamReadyRead()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!reply || reply != m_reply) {
+        return;
+    }
+
+    // Events are separated by an empty line, only events with data are updates
+    const QByteArray data = reply->readAll();
+    m_bytes->add(data.length());
+    m_buffer.append(data);
+    m_buffer.replace("\r\n", "\n");
+    qint32 end = m_buffer.indexOf("\n\n");
+    while (end >= 0) {
+        const QByteArray event = m_buffer.left(end);
+        m_buffer.remove(0, end + 2);
+        QByteArray payload;
+        foreach (const QByteArray &line, event.split('\n')) {
+            if (line.startsWith("data:")) {
+                payload.append(line.mid(5).trimmed()).append('\n');
+            }
+        }
+        if (!payload.isEmpty()) {
+            m_reconnectInterval = REALTIME_POLL_MIN;
+            this->update(payload);
+        }
+        end = m_buffer.indexOf("\n\n");
+    }
+}
+
+void Realtime::handleStreamFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    if (!reply || reply != m_reply) {
+        return; // Stopped
+    }
+    m_reply = nullptr;
+    reply->deleteLater();
+    m_buffer.clear();
+
+    // Reconnect with backoff, the server or the network dropped the stream
+    lcWarning(lcNetwork) << "Realtime stream closed:" << reply->errorString();
+    QTimer::singleShot(m_reconnectInterval, this, [this]() {
+        if (m_mode == Streaming && !m_reply) {
+            this->stream();
+        }
+    });
+    m_reconnectInterval = qMin(2 * m_reconnectInterval, REALTIME_RECONNECT_MAX);
+}
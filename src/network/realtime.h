@@ -0,0 +1,115 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <QtCore/QObject>
+#include <QtCore/QByteArray>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
+#include <QtCore/QUrl>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkConfiguration>
+#include <QtNetwork/QNetworkConfigurationManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+
+#include "../metrics/metrics.h"
+#include "connectionpage.h"
+#include "server.h"
+#include "../logging.h"
+
+#define LC_EVENTS_RESOURCE "events" // realtime events of the Linked Connections server
+#define LC_EVENTS_SSE_RESOURCE "events/sse"
+#define LCRAIL_REALTIME_VARIABLE "LCRAIL_REALTIME" // auto, poll, sse, qrail or off
+#define POWER_SUPPLY_PATH "/sys/class/power_supply"
+#define REALTIME_POLL_MIN 10000 // ms between polls right after a change
+#define REALTIME_POLL_MAX 120000 // ms between polls when nothing changes
+#define REALTIME_RECONNECT_MAX 60000 // ms before reconnecting a dropped stream
+#define REALTIME_EVALUATE_INTERVAL 60000 // ms between transport decisions
+#define REALTIME_SSE_RATE 6 // updates per minute, above this a stream is cheaper than polling
+
+// Chooses how realtime updates reach the app and emits updateReceived() for each of them.
+// Streaming (SSE) is used on Wi-Fi, while charging or when updates come in fast,
+// conditional GET polling with backoff otherwise: an unchanged resource costs a 304 only.
+// Only connected while a board or journey is watched. With LCRAIL_REALTIME=qrail the
+// watches are left to QRail's own transport instead.
+class Realtime : public QObject
+{
+    Q_OBJECT
+public:
+    enum Mode {
+        Off,
+        Polling,
+        Streaming
+    };
+    Q_ENUM(Mode)
+    static Realtime *getInstance();
+    Mode mode() const;
+    QString selection() const;
+    bool usesQRailTransport() const;
+    void setWatching(QObject *watcher, const bool &watching);
+    static QString modeName(const Mode &mode);
+
+signals:
+    void updateReceived(qint64 timestamp);
+    void connectionsUpdated(const ConnectionPage &update);
+    void modeChanged(Realtime::Mode mode);
+
+private slots:
+    void evaluate();
+    void poll();
+    void handlePollFinished();
+    void handleStreamReadyRead();
+    void handleStreamFinished();
+
+private:
+    explicit Realtime(QObject *parent = nullptr);
+    static Realtime *m_instance;
+    static bool isCharging();
+    QNetworkAccessManager *m_QNAM;
+    QNetworkConfigurationManager *m_configurations;
+    QNetworkReply *m_reply;
+    QTimer *m_pollTimer;
+    QTimer *m_evaluateTimer;
+    Mode m_mode;
+    Mode m_requestedMode; // forced by LCRAIL_REALTIME
+    QString m_selection; // LCRAIL_REALTIME value
+    bool m_automatic;
+    QSet<QObject *> m_watchers; // dispatchers with watches
+    QByteArray m_etag;
+    QByteArray m_lastModified;
+    QByteArray m_validator; // ETag, Last-Modified or body hash of the last poll, empty before the first one
+    QByteArray m_buffer; // incomplete stream event
+    qint32 m_pollInterval; // ms
+    qint32 m_reconnectInterval; // ms
+    qint32 m_updates; // since the last evaluation
+    Counter *m_bytes;
+    Counter *m_updateCount;
+    Counter *m_notModified;
+    Gauge *m_modeGauge;
+    void setMode(const Mode &mode);
+    void stop();
+    void stream();
+    void update(const QByteArray &events);
+};
+
+#endif // REALTIME_H
@@ -0,0 +1,54 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "server.h"
+
+QUrl serverResource(const QString &path)
+{
+    static const QString server = qEnvironmentVariableIsEmpty(LCRAIL_SERVER_VARIABLE)
+            ? QString(LC_SERVER) : QString::fromUtf8(qgetenv(LCRAIL_SERVER_VARIABLE));
+    return QUrl(server + "/" + path);
+}
+
+QUrl connectionsPageOf(const QDateTime &departureTime)
+{
+    // Same query as QRail: only the departure time
+    QUrl url = serverResource("connections");
+    QUrlQuery query;
+    query.addQueryItem("departureTime", departureTime.toUTC().toString(LC_DEPARTURE_TIME_FORMAT));
+    url.setQuery(query);
+    return url;
+}
+
+QUrl nextPageOf(const QByteArray &body)
+{
+    // Only the hydra:next link is needed, the page itself is parsed by the engine
+    const qint32 key = body.indexOf("\"hydra:next\"");
+    const qint32 colon = key < 0 ? -1 : body.indexOf(':', key + 12);
+    const qint32 start = colon < 0 ? -1 : body.indexOf('"', colon + 1);
+    const qint32 end = start < 0 ? -1 : body.indexOf('"', start + 1);
+    if (end < 0) {
+        return QUrl();
+    }
+    return QUrl::fromEncoded(body.mid(start + 1, end - start - 1));
+}
+
+qint64 departureOfPage(const QUrl &url)
+{
+    // ms since epoch, 0 when the URL isn't a connections page
+    const QDateTime departure = QDateTime::fromString(QUrlQuery(url).queryItemValue("departureTime"), Qt::ISODate);
+    return departure.isValid() ? departure.toMSecsSinceEpoch() : 0;
+}
@@ -0,0 +1,37 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QString>
+#include <QtCore/QUrl>
+#include <QtCore/QUrlQuery>
+
+// Linked Connections server of QRail::Fragments::Factory. Page URLs built by LCRail must be
+// identical to the ones QRail requests, otherwise QRail never finds them in the page cache.
+#define LC_SERVER "https://lc.dylanvanassche.be/sncb"
+#define LCRAIL_SERVER_VARIABLE "LCRAIL_SERVER" // overrides LC_SERVER, for example plain HTTP for the fixture proxy
+#define LC_DEPARTURE_TIME_FORMAT "yyyy-MM-ddThh:mm:ss.000Z" // UTC, QRail drops the milliseconds
+
+QUrl serverResource(const QString &path);
+QUrl connectionsPageOf(const QDateTime &departureTime);
+QUrl nextPageOf(const QByteArray &body);
+qint64 departureOfPage(const QUrl &url);
+
+#endif // SERVER_H
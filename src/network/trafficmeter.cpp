@@ -0,0 +1,38 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "trafficmeter.h"
+
+TrafficMeter::TrafficMeter(QNetworkAccessManager *QNAM) : QObject(QNAM)
+{
+    // Lives as long as the QNAM it measures
+    connect(QNAM, SIGNAL(finished(QNetworkReply *)), this, SLOT(handleFinished(QNetworkReply *)));
+
+    Metrics *metrics = Metrics::getInstance();
+    m_bytes = metrics->counter("bytes_received");
+}
+
+void TrafficMeter::handleFinished(QNetworkReply *reply)
+{
+    if (reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()) {
+        return;
+    }
+
+    // The QNAM signals before the engine's own handlers, the body is still unread
+    bool ok = false;
+    const qint64 length = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong(&ok);
+    m_bytes->add(ok ? length : reply->bytesAvailable());
+}
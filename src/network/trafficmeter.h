@@ -0,0 +1,43 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TRAFFICMETER_H
+#define TRAFFICMETER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QVariant>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+#include <QtNetwork/QNetworkRequest>
+
+#include "../metrics/metrics.h"
+
+// Counts the bytes QRail's engines receive from the network, pages served
+// from the page cache aren't counted.
+class TrafficMeter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TrafficMeter(QNetworkAccessManager *QNAM);
+
+private slots:
+    void handleFinished(QNetworkReply *reply);
+
+private:
+    Counter *m_bytes;
+};
+
+#endif // TRAFFICMETER_H
@@ -0,0 +1,102 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "notificationscheduler.h"
+
+NotificationScheduler *NotificationScheduler::m_instance = nullptr;
+
+NotificationScheduler::NotificationScheduler(QObject *parent) : QObject(parent)
+{
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(publish()));
+
+    // Scheduled vs published shows how much a burst of updates was coalesced
+    m_scheduled = Metrics::getInstance()->counter("notifications_scheduled");
+    m_publications = Metrics::getInstance()->counter("notifications_published");
+}
+
+NotificationScheduler *NotificationScheduler::getInstance()
+{
+    if (m_instance == nullptr) {
+        lcDebug(lcNotifications) << "Creating new NotificationScheduler";
+        m_instance = new NotificationScheduler();
+    }
+    return m_instance;
+}
+
+void NotificationScheduler::schedule(const QString &key, const QString &title, const QString &text,
+                                     const QString &feedback, const QString &category)
+{
+    // A newer notification about the same vehicle or route replaces the pending one
+    Pending pending = { title, text, feedback };
+    m_pending[category].insert(key, pending);
+    m_scheduled->add();
+    if (!m_timer->isActive()) {
+        m_timer->start(NOTIFICATION_BATCH_INTERVAL);
+    }
+}
+
+void NotificationScheduler::publish()
+{
+    // Categories which published recently wait for their interval to pass
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 wait = -1;
+    foreach (const QString &category, m_pending.keys()) {
+        const qint64 since = now - m_published.value(category, 0);
+        if (since < NOTIFICATION_CATEGORY_INTERVAL) {
+            const qint64 remaining = NOTIFICATION_CATEGORY_INTERVAL - since;
+            wait = wait < 0 ? remaining : qMin(wait, remaining);
+            continue;
+        }
+        this->publish(category, m_pending.take(category));
+        m_published.insert(category, now);
+    }
+
+    if (wait >= 0) {
+        m_timer->start(wait);
+    }
+}
+
+void NotificationScheduler::publish(const QString &category, const QMap<QString, Pending> &batch)
+{
+    if (batch.isEmpty()) {
+        return;
+    }
+    if (m_ids.count() > NOTIFICATION_MAX_IDS) {
+        m_ids.clear(); // Old notifications are dismissed by now, new ones are created
+    }
+
+    // A single change replaces the notification of that vehicle or route
+    if (batch.count() == 1) {
+        const QString key = batch.firstKey();
+        const Pending &pending = batch.first();
+        m_ids.insert(key, SailfishOS::createNotification(pending.title, pending.text, pending.feedback,
+                                                         category, m_ids.value(key)));
+        m_publications->add();
+        return;
+    }
+
+    // Several changes become one summary, which replaces the previous summary of the category
+    QStringList texts;
+    foreach (const Pending &pending, batch) {
+        texts.append(pending.text);
+    }
+    const QString title = QString("%1 (%2)").arg(batch.first().title).arg(batch.count());
+    m_ids.insert(category, SailfishOS::createNotification(title, texts.join("\n"), batch.first().feedback,
+                                                          category, m_ids.value(category)));
+    m_publications->add();
+}
@@ -0,0 +1,67 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef NOTIFICATIONSCHEDULER_H
+#define NOTIFICATIONSCHEDULER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+
+#include "sailfishos.h"
+#include "metrics/metrics.h"
+#include "logging.h"
+
+#define NOTIFICATION_BATCH_INTERVAL 2000 // ms to collect notifications before publishing them
+#define NOTIFICATION_CATEGORY_INTERVAL 30000 // ms between two publications in the same category
+#define NOTIFICATION_MAX_IDS 256 // remembered notification IDs
+
+// Collects notifications and publishes them in batches, away from the stream handlers.
+// Notifications about the same vehicle or route replace each other, a category shows
+// at most one publication per interval and a batch of several becomes one summary.
+class NotificationScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    static NotificationScheduler *getInstance();
+    void schedule(const QString &key, const QString &title, const QString &text,
+                  const QString &feedback, const QString &category);
+
+private slots:
+    void publish();
+
+private:
+    struct Pending {
+        QString title;
+        QString text;
+        QString feedback;
+    };
+    explicit NotificationScheduler(QObject *parent = nullptr);
+    static NotificationScheduler *m_instance;
+    QTimer *m_timer;
+    QHash<QString, QMap<QString, Pending> > m_pending; // category -> key -> latest notification
+    QHash<QString, qint64> m_published; // category -> last publication in ms since epoch
+    QHash<QString, quint32> m_ids; // key or category -> ID of the notification on screen
+    Counter *m_scheduled;
+    Counter *m_publications;
+    void publish(const QString &category, const QMap<QString, Pending> &batch);
+};
+
+#endif // NOTIFICATIONSCHEDULER_H
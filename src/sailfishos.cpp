@@ -5,7 +5,15 @@ SailfishOS::SailfishOS(QObject *parent) : QObject(parent)
 
 }
 
-void SailfishOS::createNotification(QString title, QString text, QString feedback, QString category) {
+quint32 SailfishOS::createNotification(QString title, QString text, QString feedback, QString category,
+                                      quint32 replacesId) {
+#ifdef LCRAIL_HEADLESS
+    // No notification daemon in headless builds
+    Q_UNUSED(feedback);
+    Q_UNUSED(category);
+    lcDebug(lcNotifications) << "Notification:" << title << text;
+    return replacesId;
+#else
     // Trim when too long
     const QString body = text.length() > MAX_BODY_LENGTH ? text.left(MAX_BODY_LENGTH-3) + "..." : text;
     const QString preview = text.length() > MAX_PREVIEW_LENGTH ? text.left(MAX_PREVIEW_LENGTH-3) + "..." : text;
@@ -21,5 +29,8 @@ void SailfishOS::createNotification(QString title, QString text, QString feedbac
     notification.setHintValue("x-nemo-feedback", feedback);
     notification.setHintValue("x-nemo-priority", 120);
     notification.setHintValue("x-nemo-display-on", true);
+    notification.setReplacesId(replacesId); // 0 is a new notification
     notification.publish();
+    return notification.replacesId();
+#endif
 }
@@ -2,7 +2,10 @@
 #define SAILFISHOS_H
 
 #include <QtCore/QObject>
+#include "logging.h"
+#ifndef LCRAIL_HEADLESS
 #include <nemonotifications-qt5/notification.h>
+#endif
 #define MAX_BODY_LENGTH 200
 #define MAX_PREVIEW_LENGTH 100
 
@@ -11,7 +14,8 @@ class SailfishOS : public QObject
     Q_OBJECT
 public:
     explicit SailfishOS(QObject *parent = nullptr);
-    static void createNotification(QString title, QString text, QString feedback, QString category);
+    static quint32 createNotification(QString title, QString text, QString feedback, QString category,
+                                      quint32 replacesId = 0);
 };
 
 #endif // SAILFISHOS_H
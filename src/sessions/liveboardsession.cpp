@@ -0,0 +1,391 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "liveboardsession.h"
+
+LiveboardDispatcher *LiveboardDispatcher::m_instance = nullptr;
+
+// Stop of the vehicle in the station of the liveboard
+static QString stationOf(QRail::VehicleEngine::Vehicle *vehicle)
+{
+    if (vehicle->intermediaryStops().isEmpty()) {
+        return QString();
+    }
+    return vehicle->intermediaryStops().first()->station()->uri().toString();
+}
+
+LiveboardSession::LiveboardSession(QObject *parent) : QObject(parent)
+{
+    m_dispatcher = LiveboardDispatcher::getInstance();
+}
+
+LiveboardSession::~LiveboardSession()
+{
+    m_dispatcher->cancel(this);
+    m_dispatcher->unwatch(this);
+}
+
+void LiveboardSession::getLiveboardByStationURI(const QUrl &uri, const QRail::LiveboardEngine::Board::Mode &mode)
+{
+    LiveboardDispatcher::Request request = { this, LiveboardDispatcher::Board, uri, QDateTime(), QDateTime(), mode, nullptr };
+    m_dispatcher->enqueue(request);
+}
+
+void LiveboardSession::getLiveboardByStationURI(const QUrl &uri, const QDateTime &from, const QDateTime &until,
+                                                const QRail::LiveboardEngine::Board::Mode &mode)
+{
+    LiveboardDispatcher::Request request = { this, LiveboardDispatcher::BoardWindow, uri, from, until, mode, nullptr };
+    m_dispatcher->enqueue(request);
+}
+
+void LiveboardSession::getNextResultsForLiveboard(QRail::LiveboardEngine::Board *board)
+{
+    LiveboardDispatcher::Request request = { this, LiveboardDispatcher::Next, board->station()->uri(),
+                                             QDateTime(), QDateTime(), board->mode(), board };
+    m_dispatcher->enqueue(request);
+}
+
+void LiveboardSession::getPreviousResultsForLiveboard(QRail::LiveboardEngine::Board *board)
+{
+    LiveboardDispatcher::Request request = { this, LiveboardDispatcher::Previous, board->station()->uri(),
+                                             QDateTime(), QDateTime(), board->mode(), board };
+    m_dispatcher->enqueue(request);
+}
+
+void LiveboardSession::cancel()
+{
+    m_dispatcher->cancel(this);
+}
+
+void LiveboardSession::watch(QRail::LiveboardEngine::Board *board)
+{
+    m_dispatcher->watch(this, board);
+}
+
+void LiveboardSession::unwatch()
+{
+    m_dispatcher->unwatch(this);
+}
+
+LiveboardDispatcher::LiveboardDispatcher(QObject *parent) : QObject(parent)
+{
+    m_factory = QRail::LiveboardEngine::Factory::getInstance();
+    connect(m_factory,
+            SIGNAL(stream(QRail::VehicleEngine::Vehicle *)),
+            this,
+            SLOT(handleStream(QRail::VehicleEngine::Vehicle *)));
+    connect(m_factory,
+            SIGNAL(finished(QRail::LiveboardEngine::Board *)),
+            this,
+            SLOT(handleFinished(QRail::LiveboardEngine::Board *)));
+    connect(m_factory, SIGNAL(processing(QUrl)), this, SLOT(handleProcessing(QUrl)));
+    connect(m_factory, SIGNAL(error(QString)), this, SLOT(handleError(QString)));
+    connect(m_factory, SIGNAL(updateReceived(qint64)), this, SLOT(handleUpdateReceived(qint64)));
+    connect(Realtime::getInstance(), SIGNAL(connectionsUpdated(ConnectionPage)), this, SLOT(handleRealtimeUpdate(ConnectionPage)));
+
+    // Init variables
+    m_active = nullptr;
+    m_activeBoard = nullptr;
+    m_refreshing = nullptr;
+    m_updateTimestamp = 0;
+}
+
+LiveboardDispatcher *LiveboardDispatcher::getInstance()
+{
+    if (m_instance == nullptr) {
+        lcDebug(lcLiveboard) << "Creating new LiveboardDispatcher";
+        m_instance = new LiveboardDispatcher();
+    }
+    return m_instance;
+}
+
+void LiveboardDispatcher::enqueue(const Request &request)
+{
+    // A session only has one query at a time, a new one replaces the previous one
+    this->cancel(request.session);
+    m_queue.enqueue(request);
+    if (m_refreshing) {
+        this->preemptRefresh();
+    }
+    if (!this->isRunning()) {
+        this->startNext();
+    }
+}
+
+void LiveboardDispatcher::preemptRefresh()
+{
+    // User queries don't wait for background refreshes, the refresh runs again after them
+    lcDebug(lcLiveboard) << "Query preempts the refresh of" << m_activeStation;
+    m_factory->abortCurrentOperation();
+    m_refreshes.prepend(m_refreshRequest);
+    this->finishActive();
+    this->applyWatches(); // Aborting can drop the watches of the factory
+}
+
+bool LiveboardDispatcher::isRunning() const
+{
+    return m_active || m_refreshing;
+}
+
+void LiveboardDispatcher::startNext()
+{
+    // User queries go first, refreshes only run when no query is waiting
+    if (m_queue.isEmpty()) {
+        if (m_refreshes.isEmpty()) {
+            return;
+        }
+        const Request request = m_refreshes.dequeue();
+
+        // The board may have been replaced or unwatched while the refresh was queued
+        if (!this->isWatched(request.board)) {
+            this->startNext();
+            return;
+        }
+        m_refreshing = request.board;
+        m_refreshRequest = request;
+        m_activeStation = request.uri.toString();
+        m_factory->getLiveboardByStationURI(request.uri, request.from, request.until, request.mode);
+        return;
+    }
+
+    const Request request = m_queue.dequeue();
+    m_active = request.session;
+    m_activeStation = request.uri.toString();
+    m_activeBoard = request.board;
+    switch (request.kind) {
+    case Board:
+        m_factory->getLiveboardByStationURI(request.uri, request.mode);
+        break;
+    case BoardWindow:
+        m_factory->getLiveboardByStationURI(request.uri, request.from, request.until, request.mode);
+        break;
+    case Next:
+        m_factory->getNextResultsForLiveboard(request.board);
+        break;
+    case Previous:
+        m_factory->getPreviousResultsForLiveboard(request.board);
+        break;
+    }
+}
+
+void LiveboardDispatcher::finishActive()
+{
+    m_active = nullptr;
+    m_activeStation.clear();
+    m_activeBoard = nullptr;
+    m_refreshing = nullptr;
+}
+
+void LiveboardDispatcher::cancel(LiveboardSession *session)
+{
+    // Queued queries are dropped, only the running query of this session is aborted
+    for (qint32 i = m_queue.length() - 1; i >= 0; i--) {
+        if (m_queue.at(i).session == session) {
+            m_queue.removeAt(i);
+        }
+    }
+    if (m_active == session) {
+        m_factory->abortCurrentOperation();
+        this->finishActive();
+        this->applyWatches(); // Aborting can drop the watches of the factory
+        this->startNext();
+    }
+}
+
+void LiveboardDispatcher::watch(LiveboardSession *session, QRail::LiveboardEngine::Board *board)
+{
+    Watch watch = { board, board->station()->uri().toString(), board->from(), board->until(), board->mode() };
+    m_watches.insert(session, watch);
+    this->applyWatches();
+}
+
+void LiveboardDispatcher::unwatch(LiveboardSession *session)
+{
+    m_updating.remove(session);
+    if (m_watches.remove(session) > 0) {
+        this->applyWatches();
+    }
+}
+
+void LiveboardDispatcher::applyWatches()
+{
+    // The factory only supports unwatching everything, the boards still in use are watched again.
+    // Only with QRail's transport, the app's own transport refreshes them in handleRealtimeUpdate.
+    m_factory->unwatchAll();
+    Realtime *realtime = Realtime::getInstance();
+    realtime->setWatching(this, !m_watches.isEmpty());
+    if (!realtime->usesQRailTransport()) {
+        return;
+    }
+    QList<QRail::LiveboardEngine::Board *> watched;
+    foreach (const Watch &watch, m_watches) {
+        if (!watched.contains(watch.board)) {
+            watched.append(watch.board);
+            m_factory->watch(watch.board);
+        }
+    }
+}
+
+bool LiveboardDispatcher::isWatched(QRail::LiveboardEngine::Board *board) const
+{
+    foreach (const Watch &watch, m_watches) {
+        if (watch.board == board) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void LiveboardDispatcher::notifyUpdate(LiveboardSession *session)
+{
+    // Sessions hear about an update when its first event for their board arrives,
+    // the others aren't affected by it and stay idle.
+    if (m_updateTimestamp > 0 && !m_updating.contains(session)) {
+        m_updating.insert(session);
+        emit session->updateReceived(m_updateTimestamp);
+    }
+}
+
+void LiveboardDispatcher::handleStream(QRail::VehicleEngine::Vehicle *vehicle)
+{
+    this->dispatchStream(vehicle, stationOf(vehicle));
+}
+
+void LiveboardDispatcher::dispatchStream(QRail::VehicleEngine::Vehicle *vehicle, const QString &station)
+{
+    // Results of the running query, otherwise updates of the boards watched in that station
+    if (m_active && station == m_activeStation) {
+        emit m_active->stream(vehicle);
+        return;
+    }
+    QHash<LiveboardSession *, Watch>::const_iterator it;
+    for (it = m_watches.constBegin(); it != m_watches.constEnd(); ++it) {
+        if (it.value().station == station) {
+            this->notifyUpdate(it.key());
+            emit it.key()->stream(vehicle);
+        }
+    }
+}
+
+void LiveboardDispatcher::handleFinished(QRail::LiveboardEngine::Board *board)
+{
+    this->dispatchFinished(board, board->station()->uri().toString());
+}
+
+void LiveboardDispatcher::dispatchFinished(QRail::LiveboardEngine::Board *board, const QString &station)
+{
+    // The running query finishes with the board it extends or with a new board of its station,
+    // a watched board finishing is the end of a realtime update.
+    const bool active = m_active && (m_activeBoard ? board == m_activeBoard
+                                                   : station == m_activeStation && !this->isWatched(board));
+    if (active) {
+        LiveboardSession *session = m_active;
+        this->finishActive();
+        emit session->finished(board);
+        this->startNext();
+        return;
+    }
+
+    // A refresh finishes with a new board of the station, it replaces the refreshed board
+    if (m_refreshing && station == m_activeStation && !this->isWatched(board)) {
+        QRail::LiveboardEngine::Board *refreshed = m_refreshing;
+        this->finishActive();
+        this->finishUpdate(refreshed, board);
+        this->startNext();
+        return;
+    }
+    this->finishUpdate(board, board);
+}
+
+void LiveboardDispatcher::finishUpdate(QRail::LiveboardEngine::Board *watched, QRail::LiveboardEngine::Board *board)
+{
+    QList<LiveboardSession *> sessions;
+    QHash<LiveboardSession *, Watch>::const_iterator it;
+    for (it = m_watches.constBegin(); it != m_watches.constEnd(); ++it) {
+        if (it.value().board == watched) {
+            sessions.append(it.key());
+        }
+    }
+    foreach (LiveboardSession *session, sessions) {
+        this->notifyUpdate(session);
+        m_updating.remove(session);
+        emit session->finished(board);
+    }
+}
+
+void LiveboardDispatcher::handleProcessing(const QUrl &uri)
+{
+    if (m_active) {
+        emit m_active->processing(uri);
+    }
+}
+
+void LiveboardDispatcher::handleError(const QString &message)
+{
+    // Error of the running query, otherwise of the realtime update
+    if (m_active) {
+        LiveboardSession *session = m_active;
+        this->finishActive();
+        emit session->error(message);
+        this->startNext();
+        return;
+    }
+    const QSet<LiveboardSession *> sessions = m_updating;
+    m_updating.clear();
+    foreach (LiveboardSession *session, sessions) {
+        emit session->error(message);
+    }
+    if (m_refreshing) {
+        this->finishActive();
+        this->startNext();
+    }
+}
+
+void LiveboardDispatcher::handleUpdateReceived(qint64 timestamp)
+{
+    // Updates don't carry a station, the sessions are informed when the events of their board arrive
+    m_updateTimestamp = timestamp;
+    m_updating.clear();
+}
+
+bool LiveboardDispatcher::isTouched(const Watch &watch, const ConnectionPage &update)
+{
+    // Vehicles departing or arriving in the station of the board during its window
+    const qint64 from = watch.from.isValid() ? watch.from.toMSecsSinceEpoch() : 0;
+    const qint64 until = watch.until.isValid() ? watch.until.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max();
+    return update.servesStop(UriTable::getInstance()->find(watch.station), from, until);
+}
+
+void LiveboardDispatcher::handleRealtimeUpdate(const ConnectionPage &update)
+{
+    // Event of the app's own transport: the watched boards it touches are fetched again once,
+    // their sessions hear about the update when the first event of the refresh arrives.
+    this->handleUpdateReceived(QDateTime::currentMSecsSinceEpoch());
+    QList<QRail::LiveboardEngine::Board *> queued;
+    foreach (const Request &request, m_refreshes) {
+        queued.append(request.board);
+    }
+    foreach (const Watch &watch, m_watches) {
+        if (!queued.contains(watch.board) && LiveboardDispatcher::isTouched(watch, update)) {
+            queued.append(watch.board);
+            Request request = { nullptr, Refresh, QUrl(watch.station), watch.from, watch.until, watch.mode, watch.board };
+            m_refreshes.enqueue(request);
+        }
+    }
+    if (!this->isRunning()) {
+        this->startNext();
+    }
+}
@@ -0,0 +1,144 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef LIVEBOARDSESSION_H
+#define LIVEBOARDSESSION_H
+
+#include <QtCore/QObject>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QQueue>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QUrl>
+#include <limits>
+
+#include "engines/liveboard/liveboardboard.h"
+#include "engines/liveboard/liveboardfactory.h"
+#include "engines/station/stationstation.h"
+#include "engines/vehicle/vehiclevehicle.h"
+#include "../network/connectionpage.h"
+#include "../network/realtime.h"
+#include "../logging.h"
+
+class LiveboardDispatcher;
+
+// Result channel, cancellation and watch subscription of one liveboard query.
+// Sessions only receive the events of their own query and watched board.
+class LiveboardSession : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LiveboardSession(QObject *parent = nullptr);
+    ~LiveboardSession();
+    void getLiveboardByStationURI(const QUrl &uri, const QRail::LiveboardEngine::Board::Mode &mode);
+    void getLiveboardByStationURI(const QUrl &uri, const QDateTime &from, const QDateTime &until,
+                                  const QRail::LiveboardEngine::Board::Mode &mode);
+    void getNextResultsForLiveboard(QRail::LiveboardEngine::Board *board);
+    void getPreviousResultsForLiveboard(QRail::LiveboardEngine::Board *board);
+    void cancel();
+    void watch(QRail::LiveboardEngine::Board *board);
+    void unwatch();
+
+signals:
+    void stream(QRail::VehicleEngine::Vehicle *vehicle);
+    void finished(QRail::LiveboardEngine::Board *board);
+    void processing(const QUrl &uri);
+    void error(const QString &message);
+    void updateReceived(qint64 timestamp);
+
+private:
+    LiveboardDispatcher *m_dispatcher;
+};
+
+// Shares the Factory between sessions: queries run one after another and every event
+// is routed to the session it belongs to. Watches are reference counted per board.
+// User queries run before queued refreshes and preempt a running one.
+// The factory emits stream and finished again for watched boards after a realtime update,
+// those only go to the sessions watching the board and don't end the running query.
+// With the app's own realtime transport, the dispatcher refreshes the watched boards itself,
+// only the boards of the stations served by the updated connections during their window.
+class LiveboardDispatcher : public QObject
+{
+    Q_OBJECT
+public:
+    enum Kind {
+        Board,
+        BoardWindow,
+        Next,
+        Previous,
+        Refresh // watched board after a realtime update
+    };
+    struct Request {
+        LiveboardSession *session;
+        Kind kind;
+        QUrl uri;
+        QDateTime from;
+        QDateTime until;
+        QRail::LiveboardEngine::Board::Mode mode;
+        QRail::LiveboardEngine::Board *board;
+    };
+    struct Watch {
+        QRail::LiveboardEngine::Board *board;
+        QString station;
+        QDateTime from; // window and mode of the board when it was watched
+        QDateTime until;
+        QRail::LiveboardEngine::Board::Mode mode;
+    };
+    static LiveboardDispatcher *getInstance();
+    void enqueue(const Request &request);
+    void cancel(LiveboardSession *session);
+    void watch(LiveboardSession *session, QRail::LiveboardEngine::Board *board);
+    void unwatch(LiveboardSession *session);
+
+private slots:
+    void handleStream(QRail::VehicleEngine::Vehicle *vehicle);
+    void handleFinished(QRail::LiveboardEngine::Board *board);
+    void handleProcessing(const QUrl &uri);
+    void handleError(const QString &message);
+    void handleUpdateReceived(qint64 timestamp);
+    void handleRealtimeUpdate(const ConnectionPage &update);
+
+private:
+    friend class TestSessions;
+    explicit LiveboardDispatcher(QObject *parent = nullptr);
+    static LiveboardDispatcher *m_instance;
+    QRail::LiveboardEngine::Factory *m_factory;
+    QQueue<Request> m_queue; // user queries, before any refresh
+    QQueue<Request> m_refreshes; // watched boards to refresh after a realtime update
+    Request m_refreshRequest; // running refresh, queued again when a query preempts it
+    LiveboardSession *m_active;
+    QString m_activeStation;
+    QRail::LiveboardEngine::Board *m_activeBoard; // board extended by the running query, if any
+    QRail::LiveboardEngine::Board *m_refreshing; // watched board being refreshed, if any
+    QHash<LiveboardSession *, Watch> m_watches; // session -> watched board
+    QSet<LiveboardSession *> m_updating; // watchers told about the running realtime update
+    qint64 m_updateTimestamp; // 0 when no update is running
+    bool isRunning() const;
+    void startNext();
+    void preemptRefresh();
+    void finishActive();
+    void applyWatches();
+    void notifyUpdate(LiveboardSession *session);
+    void dispatchStream(QRail::VehicleEngine::Vehicle *vehicle, const QString &station);
+    void dispatchFinished(QRail::LiveboardEngine::Board *board, const QString &station);
+    void finishUpdate(QRail::LiveboardEngine::Board *watched, QRail::LiveboardEngine::Board *board);
+    bool isWatched(QRail::LiveboardEngine::Board *board) const;
+    static bool isTouched(const Watch &watch, const ConnectionPage &update);
+};
+
+#endif // LIVEBOARDSESSION_H
@@ -0,0 +1,400 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "routersession.h"
+
+RouterDispatcher *RouterDispatcher::m_instance = nullptr;
+
+// Departure and arrival station of a route
+static QPair<QUrl, QUrl> stationsOf(const QSharedPointer<QRail::RouterEngine::Route> &route)
+{
+    if (route->legs().isEmpty()) {
+        return QPair<QUrl, QUrl>();
+    }
+    return qMakePair(route->legs().first()->departure()->station()->uri(),
+                     route->legs().last()->arrival()->station()->uri());
+}
+
+RouterSession::RouterSession(QObject *parent) : QObject(parent)
+{
+    m_dispatcher = RouterDispatcher::getInstance();
+}
+
+RouterSession::~RouterSession()
+{
+    m_dispatcher->cancel(this);
+    m_dispatcher->unwatch(this);
+}
+
+void RouterSession::getConnections(const QUrl &departureStation, const QUrl &arrivalStation,
+                                   const QDateTime &departureTime, const quint16 &maxTransfers)
+{
+    RouterDispatcher::Request request = { this, departureStation, arrivalStation, departureTime, maxTransfers, nullptr };
+    m_dispatcher->enqueue(request);
+}
+
+void RouterSession::cancel()
+{
+    m_dispatcher->cancel(this);
+}
+
+void RouterSession::watch(QRail::RouterEngine::Journey *journey)
+{
+    m_dispatcher->watch(this, journey);
+}
+
+void RouterSession::unwatch()
+{
+    m_dispatcher->unwatch(this);
+}
+
+RouterDispatcher::RouterDispatcher(QObject *parent) : QObject(parent)
+{
+    m_planner = QRail::RouterEngine::Planner::getInstance();
+    connect(m_planner,
+            SIGNAL(stream(QSharedPointer<QRail::RouterEngine::Route>)),
+            this,
+            SLOT(handleStream(QSharedPointer<QRail::RouterEngine::Route>)));
+    connect(m_planner,
+            SIGNAL(finished(QRail::RouterEngine::Journey *)),
+            this,
+            SLOT(handleFinished(QRail::RouterEngine::Journey *)));
+    connect(m_planner, SIGNAL(processing(QUrl)), this, SLOT(handleProcessing(QUrl)));
+    connect(m_planner, SIGNAL(error(QString)), this, SLOT(handleError(QString)));
+    connect(m_planner, SIGNAL(updateReceived(qint64)), this, SLOT(handleUpdateReceived(qint64)));
+    connect(Realtime::getInstance(), SIGNAL(connectionsUpdated(ConnectionPage)), this, SLOT(handleRealtimeUpdate(ConnectionPage)));
+
+    // Init variables
+    m_active = nullptr;
+    m_refreshing = nullptr;
+    m_updateTimestamp = 0;
+}
+
+RouterDispatcher *RouterDispatcher::getInstance()
+{
+    if (m_instance == nullptr) {
+        lcDebug(lcRouter) << "Creating new RouterDispatcher";
+        m_instance = new RouterDispatcher();
+    }
+    return m_instance;
+}
+
+void RouterDispatcher::enqueue(const Request &request)
+{
+    // A session only has one query at a time, a new one replaces the previous one
+    this->cancel(request.session);
+    m_queue.enqueue(request);
+    if (m_refreshing) {
+        this->preemptRefresh();
+    }
+    if (!this->isRunning()) {
+        this->startNext();
+    }
+}
+
+void RouterDispatcher::preemptRefresh()
+{
+    // User queries don't wait for background replans, the replan runs again after them
+    lcDebug(lcRouter) << "Query preempts a journey replan";
+    m_planner->abortCurrentOperation();
+    Request refresh = m_activeRequest;
+    refresh.stops.clear();
+    refresh.until = QDateTime();
+    m_refreshes.prepend(refresh);
+    m_refreshing = nullptr;
+    this->applyWatches(); // Aborting can drop the watches of the planner
+}
+
+bool RouterDispatcher::isRunning() const
+{
+    return m_active || m_refreshing;
+}
+
+void RouterDispatcher::startNext()
+{
+    // User queries go first, replans only run when no query is waiting
+    if (m_queue.isEmpty() && m_refreshes.isEmpty()) {
+        return;
+    }
+
+    const Request request = m_queue.isEmpty() ? m_refreshes.dequeue() : m_queue.dequeue();
+    if (request.journey) {
+        // The journey may have been unwatched while it was queued
+        if (!this->isWatched(request.journey)) {
+            this->startNext();
+            return;
+        }
+        m_refreshing = request.journey;
+    }
+    else {
+        m_active = request.session;
+        m_lastQuery.insert(request.session, request);
+    }
+    m_activeRequest = request;
+    m_planner->getConnections(request.departureStation,
+                              request.arrivalStation,
+                              request.departureTime,
+                              request.maxTransfers);
+}
+
+void RouterDispatcher::cancel(RouterSession *session)
+{
+    // Queued queries are dropped, only the running query of this session is aborted
+    for (qint32 i = m_queue.length() - 1; i >= 0; i--) {
+        if (m_queue.at(i).session == session) {
+            m_queue.removeAt(i);
+        }
+    }
+    if (m_active == session) {
+        m_planner->abortCurrentOperation();
+        m_active = nullptr;
+        this->applyWatches(); // Aborting can drop the watches of the planner
+        this->startNext();
+    }
+}
+
+void RouterDispatcher::watch(RouterSession *session, QRail::RouterEngine::Journey *journey)
+{
+    // Added to the journeys the session watches already, a search can consist of several queries
+    foreach (const Watch &watch, m_watches.values(session)) {
+        if (watch.journey == journey) {
+            return;
+        }
+    }
+    const Request query = m_lastQuery.value(session);
+    Watch watch = { journey, qMakePair(query.departureStation, query.arrivalStation), query.departureTime,
+                    query.maxTransfers, query.stops, query.until };
+    m_watches.insert(session, watch);
+    this->applyWatches();
+}
+
+void RouterDispatcher::unwatch(RouterSession *session)
+{
+    m_lastQuery.remove(session);
+    m_updating.remove(session);
+    if (m_watches.remove(session) > 0) {
+        this->applyWatches();
+    }
+}
+
+void RouterDispatcher::applyWatches()
+{
+    // The planner only supports unwatching everything, the journeys still in use are watched again.
+    // Only with QRail's transport, the app's own transport refreshes them in handleRealtimeUpdate.
+    m_planner->unwatchAll();
+    Realtime *realtime = Realtime::getInstance();
+    realtime->setWatching(this, !m_watches.isEmpty());
+    if (!realtime->usesQRailTransport()) {
+        return;
+    }
+    QList<QRail::RouterEngine::Journey *> watched;
+    foreach (const Watch &watch, m_watches) {
+        if (!watched.contains(watch.journey)) {
+            watched.append(watch.journey);
+            m_planner->watch(watch.journey);
+        }
+    }
+}
+
+bool RouterDispatcher::isWatched(QRail::RouterEngine::Journey *journey) const
+{
+    foreach (const Watch &watch, m_watches) {
+        if (watch.journey == journey) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RouterDispatcher::notifyUpdate(RouterSession *session)
+{
+    // Sessions hear about an update when its first event for their journey arrives,
+    // the others aren't affected by it and stay idle.
+    if (m_updateTimestamp > 0 && !m_updating.contains(session)) {
+        m_updating.insert(session);
+        emit session->updateReceived(m_updateTimestamp);
+    }
+}
+
+void RouterDispatcher::handleStream(QSharedPointer<QRail::RouterEngine::Route> route)
+{
+    this->dispatchStream(route, stationsOf(route), route->departureTime());
+}
+
+void RouterDispatcher::dispatchStream(QSharedPointer<QRail::RouterEngine::Route> route,
+                                      const QPair<QUrl, QUrl> &stations, const QDateTime &departureTime)
+{
+    // Results of the running query, otherwise updates of the journeys with the same stations and time
+    if (m_active
+            && stations == qMakePair(m_activeRequest.departureStation, m_activeRequest.arrivalStation)
+            && departureTime >= m_activeRequest.departureTime) {
+        this->recordRoute(route);
+        emit m_active->stream(route);
+        return;
+    }
+    QList<RouterSession *> sessions;
+    QMultiHash<RouterSession *, Watch>::const_iterator it;
+    for (it = m_watches.constBegin(); it != m_watches.constEnd(); ++it) {
+        if (it.value().stations == stations && departureTime >= it.value().departureTime
+                && !sessions.contains(it.key())) {
+            sessions.append(it.key());
+        }
+    }
+    if (m_refreshing && !sessions.isEmpty()) {
+        this->recordRoute(route);
+    }
+    foreach (RouterSession *session, sessions) {
+        this->notifyUpdate(session);
+        emit session->stream(route);
+    }
+}
+
+void RouterDispatcher::handleFinished(QRail::RouterEngine::Journey *journey)
+{
+    this->dispatchFinished(journey);
+}
+
+void RouterDispatcher::dispatchFinished(QRail::RouterEngine::Journey *journey)
+{
+    // The running query finishes with a new journey, a watched journey finishing is the end of a realtime update
+    if (m_active && !this->isWatched(journey)) {
+        RouterSession *session = m_active;
+        m_active = nullptr;
+        m_lastQuery.insert(session, m_activeRequest); // With the stations of its routes
+        emit session->finished(journey);
+        this->startNext();
+        return;
+    }
+
+    // Planning a watched journey again finishes with a new journey, which replaces it in every watch
+    QRail::RouterEngine::Journey *refreshed = nullptr;
+    if (m_refreshing && !this->isWatched(journey)) {
+        refreshed = m_refreshing;
+        m_refreshing = nullptr;
+        QMultiHash<RouterSession *, Watch>::iterator watch;
+        for (watch = m_watches.begin(); watch != m_watches.end(); ++watch) {
+            if (watch.value().journey == refreshed) {
+                watch.value().journey = journey;
+                watch.value().stops = m_activeRequest.stops;
+                watch.value().until = m_activeRequest.until;
+            }
+        }
+    }
+
+    QList<RouterSession *> sessions;
+    QMultiHash<RouterSession *, Watch>::const_iterator it;
+    for (it = m_watches.constBegin(); it != m_watches.constEnd(); ++it) {
+        if (it.value().journey == journey && !sessions.contains(it.key())) {
+            sessions.append(it.key());
+        }
+    }
+    foreach (RouterSession *session, sessions) {
+        this->notifyUpdate(session);
+        m_updating.remove(session);
+        emit session->finished(journey);
+    }
+    if (refreshed) {
+        this->startNext();
+    }
+}
+
+void RouterDispatcher::handleProcessing(const QUrl &uri)
+{
+    if (m_active) {
+        emit m_active->processing(uri);
+    }
+}
+
+void RouterDispatcher::handleError(const QString &message)
+{
+    // Error of the running query, otherwise of the realtime update
+    if (m_active) {
+        RouterSession *session = m_active;
+        m_active = nullptr;
+        emit session->error(message);
+        this->startNext();
+        return;
+    }
+    const QSet<RouterSession *> sessions = m_updating;
+    m_updating.clear();
+    foreach (RouterSession *session, sessions) {
+        emit session->error(message);
+    }
+    if (m_refreshing) {
+        m_refreshing = nullptr;
+        this->startNext();
+    }
+}
+
+void RouterDispatcher::handleUpdateReceived(qint64 timestamp)
+{
+    // Updates don't carry stations, the sessions are informed when the events of their journey arrive
+    m_updateTimestamp = timestamp;
+    m_updating.clear();
+}
+
+void RouterDispatcher::recordRoute(const QSharedPointer<QRail::RouterEngine::Route> &route)
+{
+    // Stations and last arrival of the planned routes, for matching realtime updates later
+    if (route.isNull()) {
+        return;
+    }
+    UriTable *uris = UriTable::getInstance();
+    foreach (QRail::RouterEngine::Transfer *transfer, route->transfers()) {
+        m_activeRequest.stops.insert(uris->intern(transfer->station()->uri().toString()));
+    }
+    if (!m_activeRequest.until.isValid() || route->arrivalTime() > m_activeRequest.until) {
+        m_activeRequest.until = route->arrivalTime();
+    }
+}
+
+bool RouterDispatcher::isTouched(const Watch &watch, const ConnectionPage &update)
+{
+    // A station of the search or of its routes, served between the departure and the last arrival
+    const qint64 from = watch.departureTime.isValid() ? watch.departureTime.toMSecsSinceEpoch() : 0;
+    const qint64 until = watch.until.isValid() ? watch.until.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max();
+    UriTable *uris = UriTable::getInstance();
+    QSet<quint32> stops = watch.stops;
+    stops << uris->find(watch.stations.first.toString()) << uris->find(watch.stations.second.toString());
+    foreach (quint32 stop, stops) {
+        if (update.servesStop(stop, from, until)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RouterDispatcher::handleRealtimeUpdate(const ConnectionPage &update)
+{
+    // Event of the app's own transport: the watched journeys it touches are planned again once,
+    // their sessions hear about the update when the first event of the new plan arrives.
+    this->handleUpdateReceived(QDateTime::currentMSecsSinceEpoch());
+    QList<QRail::RouterEngine::Journey *> queued;
+    foreach (const Request &request, m_refreshes) {
+        queued.append(request.journey);
+    }
+    foreach (const Watch &watch, m_watches) {
+        if (!queued.contains(watch.journey) && RouterDispatcher::isTouched(watch, update)) {
+            queued.append(watch.journey);
+            Request request = { nullptr, watch.stations.first, watch.stations.second, watch.departureTime,
+                                watch.maxTransfers, watch.journey };
+            m_refreshes.enqueue(request);
+        }
+    }
+    if (!this->isRunning()) {
+        this->startNext();
+    }
+}
@@ -0,0 +1,137 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef ROUTERSESSION_H
+#define ROUTERSESSION_H
+
+#include <QtCore/QObject>
+#include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QPair>
+#include <QtCore/QQueue>
+#include <QtCore/QSet>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QUrl>
+#include <limits>
+
+#include "engines/router/routerplanner.h"
+#include "engines/router/routerjourney.h"
+#include "engines/router/routerroute.h"
+#include "engines/router/routertransfer.h"
+#include "../network/connectionpage.h"
+#include "../network/realtime.h"
+#include "../logging.h"
+
+class RouterDispatcher;
+
+// Result channel, cancellation and watch subscriptions of one route query.
+// Sessions only receive the events of their own query and watched journeys,
+// every query of a search (earlier and later routes too) keeps its journey watched.
+class RouterSession : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RouterSession(QObject *parent = nullptr);
+    ~RouterSession();
+    void getConnections(const QUrl &departureStation, const QUrl &arrivalStation,
+                        const QDateTime &departureTime, const quint16 &maxTransfers);
+    void cancel();
+    void watch(QRail::RouterEngine::Journey *journey);
+    void unwatch(); // All journeys of the session
+
+signals:
+    void stream(QSharedPointer<QRail::RouterEngine::Route> route);
+    void finished(QRail::RouterEngine::Journey *journey);
+    void processing(const QUrl &uri);
+    void error(const QString &message);
+    void updateReceived(qint64 timestamp);
+
+private:
+    RouterDispatcher *m_dispatcher;
+};
+
+// Shares the Planner between sessions: queries run one after another and every event
+// is routed to the session it belongs to. Watches are reference counted per journey.
+// User queries run before queued replans and preempt a running one.
+// The planner emits stream and finished again for watched journeys after a realtime update,
+// those only go to the sessions watching the journey and don't end the running query.
+// With the app's own realtime transport, the dispatcher plans the watched journeys again itself,
+// only the journeys with a station served by the updated connections while their routes run.
+class RouterDispatcher : public QObject
+{
+    Q_OBJECT
+public:
+    struct Request {
+        RouterSession *session;
+        QUrl departureStation;
+        QUrl arrivalStation;
+        QDateTime departureTime;
+        quint16 maxTransfers;
+        QRail::RouterEngine::Journey *journey; // watched journey planned again, nullptr for queries
+        QSet<quint32> stops; // stations of the streamed routes, collected while the query runs
+        QDateTime until; // last arrival of the streamed routes
+    };
+    struct Watch {
+        QRail::RouterEngine::Journey *journey;
+        QPair<QUrl, QUrl> stations; // departure and arrival station of the journey
+        QDateTime departureTime; // routes of the journey depart after it
+        quint16 maxTransfers;
+        QSet<quint32> stops; // stations of the journey's routes
+        QDateTime until; // last arrival of the journey's routes
+    };
+    static RouterDispatcher *getInstance();
+    void enqueue(const Request &request);
+    void cancel(RouterSession *session);
+    void watch(RouterSession *session, QRail::RouterEngine::Journey *journey);
+    void unwatch(RouterSession *session);
+
+private slots:
+    void handleStream(QSharedPointer<QRail::RouterEngine::Route> route);
+    void handleFinished(QRail::RouterEngine::Journey *journey);
+    void handleProcessing(const QUrl &uri);
+    void handleError(const QString &message);
+    void handleUpdateReceived(qint64 timestamp);
+    void handleRealtimeUpdate(const ConnectionPage &update);
+
+private:
+    friend class TestSessions;
+    explicit RouterDispatcher(QObject *parent = nullptr);
+    static RouterDispatcher *m_instance;
+    QRail::RouterEngine::Planner *m_planner;
+    QQueue<Request> m_queue; // user queries, before any replan
+    QQueue<Request> m_refreshes; // watched journeys to plan again after a realtime update
+    RouterSession *m_active;
+    Request m_activeRequest;
+    QRail::RouterEngine::Journey *m_refreshing; // watched journey being planned again, if any
+    QHash<RouterSession *, Request> m_lastQuery; // session -> its last query
+    QMultiHash<RouterSession *, Watch> m_watches; // session -> watched journeys
+    QSet<RouterSession *> m_updating; // watchers told about the running realtime update
+    qint64 m_updateTimestamp; // 0 when no update is running
+    bool isRunning() const;
+    void startNext();
+    void preemptRefresh();
+    void applyWatches();
+    void notifyUpdate(RouterSession *session);
+    void dispatchStream(QSharedPointer<QRail::RouterEngine::Route> route,
+                        const QPair<QUrl, QUrl> &stations, const QDateTime &departureTime);
+    void dispatchFinished(QRail::RouterEngine::Journey *journey);
+    bool isWatched(QRail::RouterEngine::Journey *journey) const;
+    static bool isTouched(const Watch &watch, const ConnectionPage &update);
+    void recordRoute(const QSharedPointer<QRail::RouterEngine::Route> &route);
+};
+
+#endif // ROUTERSESSION_H
@@ -0,0 +1,50 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "frametracer.h"
+
+FrameTracer::FrameTracer(QQuickWindow *window) : QObject(window)
+{
+    // Direct connections: the slots run on the render thread while the GUI thread is blocked
+    connect(window, SIGNAL(beforeSynchronizing()), this, SLOT(handleBeforeSynchronizing()), Qt::DirectConnection);
+    connect(window, SIGNAL(afterSynchronizing()), this, SLOT(handleAfterSynchronizing()), Qt::DirectConnection);
+    connect(window, SIGNAL(beforeRendering()), this, SLOT(handleBeforeRendering()), Qt::DirectConnection);
+    connect(window, SIGNAL(afterRendering()), this, SLOT(handleAfterRendering()), Qt::DirectConnection);
+
+    // Init variables
+    m_synchronizing = 0;
+    m_rendering = 0;
+}
+
+void FrameTracer::handleBeforeSynchronizing()
+{
+    m_synchronizing = Tracer::now();
+}
+
+void FrameTracer::handleAfterSynchronizing()
+{
+    Tracer::getInstance()->complete("render", "synchronize", m_synchronizing, Tracer::now());
+}
+
+void FrameTracer::handleBeforeRendering()
+{
+    m_rendering = Tracer::now();
+}
+
+void FrameTracer::handleAfterRendering()
+{
+    Tracer::getInstance()->complete("render", "render", m_rendering, Tracer::now());
+}
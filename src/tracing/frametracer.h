@@ -0,0 +1,43 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef FRAMETRACER_H
+#define FRAMETRACER_H
+
+#include <QtCore/QObject>
+#include <QtQuick/QQuickWindow>
+
+#include "tracer.h"
+
+// Traces the synchronization and rendering of every frame on the scene graph render thread
+class FrameTracer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameTracer(QQuickWindow *window);
+
+private slots:
+    void handleBeforeSynchronizing();
+    void handleAfterSynchronizing();
+    void handleBeforeRendering();
+    void handleAfterRendering();
+
+private:
+    qint64 m_synchronizing;
+    qint64 m_rendering;
+};
+
+#endif // FRAMETRACER_H
@@ -0,0 +1,208 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "tracer.h"
+
+Tracer *Tracer::m_instance = nullptr;
+bool Tracer::m_enabled = false;
+
+static thread_local void *threadBuffer = nullptr;
+
+static QElapsedTimer startedClock()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+}
+
+Tracer::Tracer(QObject *parent) : QObject(parent)
+{
+    // Tracing is enabled at runtime by giving the path of the trace, it's written when the app quits
+    m_path = QString::fromLocal8Bit(qgetenv(LCRAIL_TRACE_VARIABLE));
+#ifdef LCRAIL_TRACING
+    m_enabled = !m_path.isEmpty();
+#else
+    if (!m_path.isEmpty()) {
+        qWarning() << "Tracing isn't compiled in, rebuild with qmake CONFIG+=tracing";
+    }
+#endif
+    if (m_enabled && QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(save()));
+    }
+}
+
+Tracer *Tracer::getInstance()
+{
+    if (m_instance == nullptr) {
+        qDebug() << "Creating new Tracer";
+        m_instance = new Tracer();
+    }
+    return m_instance;
+}
+
+bool Tracer::isEnabled()
+{
+    return m_enabled;
+}
+
+qint64 Tracer::now()
+{
+    // Monotonic clock anchored to the wall clock, so update timestamps from QRail line up with the spans
+    static const qint64 epoch = QDateTime::currentMSecsSinceEpoch() * 1000;
+    static const QElapsedTimer clock = startedClock();
+    return epoch + clock.nsecsElapsed() / 1000;
+}
+
+Tracer::Buffer *Tracer::buffer()
+{
+    if (threadBuffer) {
+        return static_cast<Buffer *>(threadBuffer);
+    }
+
+    // Buffers outlive their thread, events of finished worker threads are kept for the trace
+    Buffer *buffer = new Buffer();
+    buffer->events.resize(TRACER_RING_SIZE);
+    buffer->next = 0;
+    buffer->wrapped = false;
+    buffer->thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    buffer->threadName = QThread::currentThread()->objectName();
+    if (buffer->threadName.isEmpty()) {
+        buffer->threadName = QThread::currentThread() == qApp->thread() ? "main" : "worker";
+    }
+    QMutexLocker locker(&m_buffersLock);
+    m_buffers.append(buffer);
+    threadBuffer = buffer;
+    return buffer;
+}
+
+void Tracer::append(const Event &event)
+{
+    Buffer *buffer = this->buffer();
+    QMutexLocker locker(&buffer->lock);
+    buffer->events[buffer->next] = event;
+    buffer->next = (buffer->next + 1) % TRACER_RING_SIZE;
+    buffer->wrapped = buffer->wrapped || buffer->next == 0;
+}
+
+void Tracer::complete(const char *category, const char *name, const qint64 &start, const qint64 &end)
+{
+    Event event = { category, name, 'X', start, end - start, QString() };
+    this->append(event);
+}
+
+void Tracer::instant(const char *category, const char *name, const QString &argument)
+{
+    Event event = { category, name, 'i', Tracer::now(), 0, argument };
+    this->append(event);
+}
+
+void Tracer::save()
+{
+    if (!m_enabled) {
+        return;
+    }
+
+    // Chrome trace event format, can be opened in chrome://tracing or ui.perfetto.dev
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+    QMutexLocker buffersLocker(&m_buffersLock);
+    foreach (Buffer *buffer, m_buffers) {
+        QMutexLocker locker(&buffer->lock);
+        QJsonObject thread;
+        thread["name"] = "thread_name";
+        thread["ph"] = "M";
+        thread["pid"] = pid;
+        thread["tid"] = qint64(buffer->thread);
+        thread["args"] = QJsonObject({{"name", buffer->threadName}});
+        events.append(thread);
+
+        const qint32 count = buffer->wrapped ? TRACER_RING_SIZE : buffer->next;
+        const qint32 first = buffer->wrapped ? buffer->next : 0;
+        for (qint32 i = 0; i < count; i++) {
+            const Event &event = buffer->events.at((first + i) % TRACER_RING_SIZE);
+            QJsonObject object;
+            object["cat"] = QString::fromLatin1(event.category);
+            object["name"] = QString::fromLatin1(event.name);
+            object["ph"] = QString(QChar::fromLatin1(event.phase));
+            object["ts"] = event.timestamp;
+            object["pid"] = pid;
+            object["tid"] = qint64(buffer->thread);
+            if (event.phase == 'X') {
+                object["dur"] = event.duration;
+            }
+            else {
+                object["s"] = "t";
+            }
+            if (!event.argument.isEmpty()) {
+                object["args"] = QJsonObject({{"uri", event.argument}});
+            }
+            events.append(object);
+        }
+    }
+
+    QFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "Unable to write trace:" << m_path << file.errorString();
+        return;
+    }
+    QJsonObject trace;
+    trace["traceEvents"] = events;
+    trace["displayTimeUnit"] = "ms";
+    file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    qDebug() << "Trace written:" << m_path << events.count() << "events";
+}
+
+TraceSpan::TraceSpan(const char *category, const char *name)
+{
+    m_category = category;
+    m_name = name;
+    m_start = Tracer::isEnabled() ? Tracer::now() : 0;
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (Tracer::isEnabled()) {
+        Tracer::getInstance()->complete(m_category, m_name, m_start, Tracer::now());
+    }
+}
+
+TraceInterval::TraceInterval(const char *category, const char *name)
+{
+    m_category = category;
+    m_name = name;
+    m_start = Tracer::now();
+}
+
+void TraceInterval::start()
+{
+    m_start = Tracer::now();
+}
+
+void TraceInterval::startAt(const qint64 &epochMSecs)
+{
+    m_start = epochMSecs * 1000;
+}
+
+qint64 TraceInterval::finish()
+{
+    const qint64 end = Tracer::now();
+#ifdef LCRAIL_TRACING
+    if (Tracer::isEnabled()) {
+        Tracer::getInstance()->complete(m_category, m_name, m_start, end);
+    }
+#endif
+    return (end - m_start) / 1000;
+}
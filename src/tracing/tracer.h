@@ -0,0 +1,123 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QString>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QDebug>
+
+// Environment variable with the path of the Chrome/Perfetto trace JSON, tracing is disabled without it
+#define LCRAIL_TRACE_VARIABLE "LCRAIL_TRACE"
+#define TRACER_RING_SIZE 16384 // events per thread, oldest events are overwritten
+
+// Spans are only compiled in with qmake CONFIG+=tracing.
+// Names and categories must be string literals, nothing is copied or formatted while tracing.
+#ifdef LCRAIL_TRACING
+#define TRACE_CONCAT_(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(category, name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(category, name)
+#define TRACE_INSTANT(category, name, argument) \
+    do { if (Tracer::isEnabled()) { Tracer::getInstance()->instant(category, name, argument); } } while (0)
+#else
+#define TRACE_SPAN(category, name)
+#define TRACE_INSTANT(category, name, argument)
+#endif
+
+class Tracer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Event {
+        const char *category;
+        const char *name;
+        char phase; // 'X' complete span, 'i' instant
+        qint64 timestamp; // us since epoch
+        qint64 duration; // us
+        QString argument;
+    };
+    static Tracer *getInstance();
+    static bool isEnabled();
+    static qint64 now();
+    void complete(const char *category, const char *name, const qint64 &start, const qint64 &end);
+    void instant(const char *category, const char *name, const QString &argument = QString());
+
+public slots:
+    void save();
+
+private:
+    // Every thread writes to its own ring, the lock is only contended while saving
+    struct Buffer {
+        QMutex lock;
+        QVector<Event> events;
+        qint32 next;
+        bool wrapped;
+        quint64 thread;
+        QString threadName;
+    };
+    explicit Tracer(QObject *parent = nullptr);
+    static Tracer *m_instance;
+    static bool m_enabled;
+    QMutex m_buffersLock;
+    QList<Buffer *> m_buffers;
+    QString m_path;
+    Buffer *buffer();
+    void append(const Event &event);
+};
+
+// Scoped span, nested spans on the same thread show up as a hierarchy in the trace viewer
+class TraceSpan
+{
+public:
+    TraceSpan(const char *category, const char *name);
+    ~TraceSpan();
+
+private:
+    const char *m_category;
+    const char *m_name;
+    qint64 m_start;
+};
+
+// Span across event loop iterations, for example a query from request to finished model.
+// Always measures, so it can feed the benchmark signals, but is only traced when enabled.
+class TraceInterval
+{
+public:
+    TraceInterval(const char *category, const char *name);
+    void start();
+    void startAt(const qint64 &epochMSecs);
+    qint64 finish(); // elapsed ms
+
+private:
+    const char *m_category;
+    const char *m_name;
+    qint64 m_start;
+};
+
+#endif // TRACER_H
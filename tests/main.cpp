@@ -0,0 +1,48 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <QtCore/QCoreApplication>
+#include <QtTest/QtTest>
+
+#include "qrail.h"
+#include "../src/network/realtime.h"
+#include "testconnectionpage.h"
+#include "testliveboard.h"
+#include "testrouter.h"
+#include "testsessions.h"
+#include "teststationindex.h"
+
+// Model tests, build with: qmake CONFIG+=tests && make check
+int main(int argc, char *argv[])
+{
+    qputenv(LCRAIL_REALTIME_VARIABLE, "off"); // Watches in the tests never connect
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("lcrail-tests");
+    initQRail();
+
+    int status = 0;
+    TestLiveboard liveboard;
+    status |= QTest::qExec(&liveboard, argc, argv);
+    TestRouter router;
+    status |= QTest::qExec(&router, argc, argv);
+    TestSessions sessions;
+    status |= QTest::qExec(&sessions, argc, argv);
+    TestStationIndex stationIndex;
+    status |= QTest::qExec(&stationIndex, argc, argv);
+    TestConnectionPage connectionPage;
+    status |= QTest::qExec(&connectionPage, argc, argv);
+    return status;
+}
@@ -0,0 +1,121 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "testconnectionpage.h"
+
+#define TEST_STATION_A "http://irail.be/stations/NMBS/008892007"
+#define TEST_STATION_B "http://irail.be/stations/NMBS/008812005"
+#define TEST_STATION_C "http://irail.be/stations/NMBS/008814001"
+#define TEST_TRIP_1 "http://irail.be/vehicle/IC1832/20190330"
+#define TEST_TRIP_2 "http://irail.be/vehicle/L2067/20190330"
+#define TEST_START "2019-03-30T14:00:00.000Z"
+
+// Two connections, listed out of departure order
+static const char *TEST_PAGE =
+        "{\"@id\": \"https://graph.irail.be/sncb/connections?departureTime=" TEST_START "\","
+        " \"hydra:next\": \"https://graph.irail.be/sncb/connections?departureTime=2019-03-30T14:10:00.000Z\","
+        " \"@graph\": ["
+        "  {\"@id\": \"http://irail.be/connections/2\", \"departureStop\": \"" TEST_STATION_B "\","
+        "   \"arrivalStop\": \"" TEST_STATION_C "\", \"departureTime\": \"2019-03-30T14:08:00.000Z\","
+        "   \"arrivalTime\": \"2019-03-30T14:20:00.000Z\", \"gtfs:trip\": \"" TEST_TRIP_2 "\"},"
+        "  {\"@id\": \"http://irail.be/connections/1\", \"departureStop\": \"" TEST_STATION_A "\","
+        "   \"arrivalStop\": \"" TEST_STATION_B "\", \"departureTime\": \"2019-03-30T14:02:00.000Z\","
+        "   \"arrivalTime\": \"2019-03-30T14:06:00.000Z\", \"departureDelay\": 120,"
+        "   \"gtfs:trip\": \"" TEST_TRIP_1 "\"}"
+        " ]}";
+
+static qint64 msecsOf(const QString &time)
+{
+    return QDateTime::fromString(time, Qt::ISODate).toMSecsSinceEpoch();
+}
+
+static QSet<quint32> tripsOf(const QString &trip)
+{
+    return QSet<quint32>() << UriTable::getInstance()->find(trip);
+}
+
+void TestConnectionPage::parsePage()
+{
+    bool ok = false;
+    const ConnectionPage page = ConnectionPage::fromJsonLd(TEST_PAGE, &ok);
+    QVERIFY(ok);
+    QCOMPARE(page.count(), 2);
+
+    // Rows are sorted by departure time
+    QCOMPARE(page.from(), msecsOf("2019-03-30T14:02:00.000Z"));
+    QCOMPARE(page.until(), msecsOf("2019-03-30T14:08:00.000Z"));
+    QCOMPARE(page.trips().count(), 2);
+    QVERIFY(page.hasTrip(tripsOf(TEST_TRIP_1)));
+    QVERIFY(!page.hasTrip(QSet<quint32>() << UriTable::getInstance()->intern("http://irail.be/vehicle/P7000/20190330")));
+}
+
+void TestConnectionPage::parseRealtimeEvent()
+{
+    // Realtime events are single connections with prefixed terms
+    const QByteArray event = "{\"@id\": \"http://irail.be/connections/1\","
+                             " \"lc:departureStop\": \"" TEST_STATION_A "\","
+                             " \"lc:arrivalStop\": \"" TEST_STATION_B "\","
+                             " \"lc:departureTime\": \"2019-03-30T14:02:00.000Z\","
+                             " \"lc:arrivalTime\": \"2019-03-30T14:06:00.000Z\","
+                             " \"lc:departureDelay\": 300, \"gtfs:trip\": \"" TEST_TRIP_1 "\"}";
+    bool ok = false;
+    const ConnectionPage update = ConnectionPage::fromJsonLd(event, &ok);
+    QVERIFY(ok);
+    QCOMPARE(update.count(), 1);
+    QCOMPARE(update.from(), msecsOf("2019-03-30T14:02:00.000Z"));
+
+    // The same trip is found in a page parsed separately
+    const ConnectionPage page = ConnectionPage::fromJsonLd(TEST_PAGE);
+    QVERIFY(page.hasTrip(update.trips()));
+}
+
+void TestConnectionPage::parseInvalid()
+{
+    bool ok = true;
+    const ConnectionPage page = ConnectionPage::fromJsonLd("{\"@id\": \"https://graph.irail.be/sncb/stops\"}", &ok);
+    QVERIFY(!ok);
+    QVERIFY(page.isEmpty());
+    QCOMPARE(page.from(), qint64(0));
+
+    ok = true;
+    ConnectionPage::deserialize("LCRAILPC", &ok);
+    QVERIFY(!ok);
+}
+
+void TestConnectionPage::serializeRoundTrip()
+{
+    const ConnectionPage page = ConnectionPage::fromJsonLd(TEST_PAGE);
+    bool ok = false;
+    const ConnectionPage copy = ConnectionPage::deserialize(page.serialize(), &ok);
+    QVERIFY(ok);
+    QCOMPARE(copy.count(), page.count());
+    QCOMPARE(copy.from(), page.from());
+    QCOMPARE(copy.until(), page.until());
+    QCOMPARE(copy.trips(), page.trips());
+}
+
+void TestConnectionPage::servesStop()
+{
+    const ConnectionPage page = ConnectionPage::fromJsonLd(TEST_PAGE);
+    const quint32 stationB = UriTable::getInstance()->find(TEST_STATION_B);
+    const qint64 start = msecsOf(TEST_START);
+
+    // Station B: arrival at 14:06, departure at 14:08
+    QVERIFY(page.servesStop(stationB, start, start + 7 * 60000));
+    QVERIFY(page.servesStop(stationB, start + 8 * 60000, start + 3600000));
+    QVERIFY(!page.servesStop(stationB, start + 9 * 60000, start + 3600000));
+    QVERIFY(!page.servesStop(0, start, start + 3600000));
+}
@@ -0,0 +1,39 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TESTCONNECTIONPAGE_H
+#define TESTCONNECTIONPAGE_H
+
+#include <QtCore/QObject>
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtTest/QtTest>
+
+#include "../src/network/connectionpage.h"
+
+class TestConnectionPage : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parsePage();
+    void parseRealtimeEvent();
+    void parseInvalid();
+    void serializeRoundTrip();
+    void servesStop();
+};
+
+#endif // TESTCONNECTIONPAGE_H
@@ -0,0 +1,199 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "testliveboard.h"
+
+#define TEST_BOARD_START "2019-03-31T16:00:00Z"
+
+LiveboardEntry TestLiveboard::entry(const QString &uri, const qint32 &minutes, const qint32 &delay)
+{
+    LiveboardEntry entry;
+    entry.vehicle = nullptr;
+    entry.uri = uri;
+    entry.headsign = uri;
+    entry.departureTime = QDateTime::fromString(TEST_BOARD_START, Qt::ISODate).addSecs(60 * minutes + delay);
+    entry.arrivalTime = entry.departureTime;
+    entry.arrivalDelay = delay;
+    entry.departureDelay = delay;
+    entry.type = QRail::VehicleEngine::Stop::Type();
+    entry.occupancyLevel = QRail::VehicleEngine::Stop::OccupancyLevel();
+    entry.isArrivalCanceled = false;
+    entry.isDepartureCanceled = false;
+    entry.isPlatformNormal = true;
+    entry.hasLeft = false;
+    entry.isExtraStop = false;
+    return entry;
+}
+
+QStringList TestLiveboard::uris() const
+{
+    QStringList uris;
+    for (qint32 row = 0; row < m_liveboard->rowCount(QModelIndex()); row++) {
+        uris.append(m_liveboard->data(m_liveboard->index(row), Liveboard::URIRole).toString());
+    }
+    return uris;
+}
+
+void TestLiveboard::init()
+{
+    m_liveboard = new Liveboard();
+}
+
+void TestLiveboard::cleanup()
+{
+    delete m_liveboard;
+    m_liveboard = nullptr;
+}
+
+void TestLiveboard::insertBatched()
+{
+    QSignalSpy inserted(m_liveboard, SIGNAL(rowsInserted(QModelIndex, int, int)));
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("c", 30) << entry("a", 10) << entry("b", 20));
+
+    // Unsorted streamed vehicles end up sorted, in one insert
+    QCOMPARE(this->uris(), QStringList() << "a" << "b" << "c");
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(inserted.at(0).at(1).toInt(), 0);
+    QCOMPARE(inserted.at(0).at(2).toInt(), 2);
+}
+
+void TestLiveboard::insertBetweenExisting()
+{
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("a", 10) << entry("d", 40));
+    QSignalSpy inserted(m_liveboard, SIGNAL(rowsInserted(QModelIndex, int, int)));
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("e", 50) << entry("b", 20) << entry("c", 30));
+
+    // One range per gap: (b, c) before d and e at the end
+    QCOMPARE(this->uris(), QStringList() << "a" << "b" << "c" << "d" << "e");
+    QCOMPARE(inserted.count(), 2);
+    QCOMPARE(inserted.at(0).at(1).toInt(), 1);
+    QCOMPARE(inserted.at(0).at(2).toInt(), 2);
+    QCOMPARE(inserted.at(1).at(1).toInt(), 4);
+
+    // Same departure time: streaming order is kept
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("b2", 20));
+    QCOMPARE(this->uris(), QStringList() << "a" << "b" << "b2" << "c" << "d" << "e");
+}
+
+void TestLiveboard::mergeKeepsUnchangedRows()
+{
+    const QVector<LiveboardEntry> board = QVector<LiveboardEntry>() << entry("a", 10) << entry("b", 20) << entry("c", 30);
+    m_liveboard->insertEntries(board);
+    QSignalSpy inserted(m_liveboard, SIGNAL(rowsInserted(QModelIndex, int, int)));
+    QSignalSpy removed(m_liveboard, SIGNAL(rowsRemoved(QModelIndex, int, int)));
+    QSignalSpy moved(m_liveboard, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)));
+    QSignalSpy reset(m_liveboard, SIGNAL(modelReset()));
+    m_liveboard->mergeEntries(board);
+
+    QCOMPARE(this->uris(), QStringList() << "a" << "b" << "c");
+    QCOMPARE(inserted.count(), 0);
+    QCOMPARE(removed.count(), 0);
+    QCOMPARE(moved.count(), 0);
+    QCOMPARE(reset.count(), 0);
+}
+
+void TestLiveboard::mergeRemovesAndReorders()
+{
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("a", 10) << entry("b", 20)
+                               << entry("c", 30) << entry("d", 40));
+    QSignalSpy removed(m_liveboard, SIGNAL(rowsRemoved(QModelIndex, int, int)));
+    m_liveboard->mergeEntries(QVector<LiveboardEntry>() << entry("c", 30) << entry("a", 10)
+                              << entry("e", 50) << entry("d", 40));
+
+    // The final board is taken as is
+    QCOMPARE(this->uris(), QStringList() << "c" << "a" << "e" << "d");
+    QCOMPARE(removed.count(), 1);
+    QCOMPARE(removed.at(0).at(1).toInt(), 1);
+    QCOMPARE(removed.at(0).at(2).toInt(), 1);
+}
+
+void TestLiveboard::mergeDuplicatedVehicle()
+{
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("a", 10));
+    QSignalSpy inserted(m_liveboard, SIGNAL(rowsInserted(QModelIndex, int, int)));
+    m_liveboard->mergeEntries(QVector<LiveboardEntry>() << entry("a", 10) << entry("a", 10));
+
+    // The second listing runs past the end of the current rows
+    QCOMPARE(this->uris(), QStringList() << "a" << "a");
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(inserted.at(0).at(1).toInt(), 1);
+}
+
+void TestLiveboard::updateMovesUp()
+{
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("a", 10) << entry("b", 20) << entry("c", 30));
+    QSignalSpy moved(m_liveboard, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)));
+    m_liveboard->updateEntry(2, entry("c", 5));
+
+    QCOMPARE(this->uris(), QStringList() << "c" << "a" << "b");
+    QCOMPARE(moved.count(), 1);
+    QCOMPARE(moved.at(0).at(1).toInt(), 2);
+    QCOMPARE(moved.at(0).at(4).toInt(), 0);
+}
+
+void TestLiveboard::updateMovesDown()
+{
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("a", 10) << entry("b", 20) << entry("c", 30));
+    QSignalSpy moved(m_liveboard, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)));
+    QSignalSpy delayed(m_liveboard, SIGNAL(delayedCountChanged()));
+
+    // Delayed after the next departure
+    m_liveboard->updateEntry(0, entry("a", 10, 25 * 60));
+
+    QCOMPARE(this->uris(), QStringList() << "b" << "c" << "a");
+    QCOMPARE(moved.count(), 1);
+    QCOMPARE(moved.at(0).at(1).toInt(), 0);
+    QCOMPARE(moved.at(0).at(4).toInt(), 3);
+    QCOMPARE(delayed.count(), 1);
+    QCOMPARE(m_liveboard->delayedCount(), 1);
+    QCOMPARE(m_liveboard->maxDelay(), 25 * 60);
+}
+
+void TestLiveboard::updateInPlace()
+{
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("a", 10) << entry("b", 20) << entry("c", 30));
+    QSignalSpy moved(m_liveboard, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)));
+    QSignalSpy changed(m_liveboard, SIGNAL(dataChanged(QModelIndex, QModelIndex, QVector<int>)));
+    LiveboardEntry platform = entry("b", 20);
+    platform.platform = "4";
+    m_liveboard->updateEntry(1, platform);
+
+    // Only the changed role is announced
+    QCOMPARE(moved.count(), 0);
+    QCOMPARE(changed.count(), 1);
+    QCOMPARE(changed.at(0).at(0).value<QModelIndex>().row(), 1);
+    QCOMPARE(changed.at(0).at(2).value<QVector<int> >(), QVector<int>() << Liveboard::platformRole);
+}
+
+void TestLiveboard::rowIndexFollowsChanges()
+{
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("a", 10) << entry("c", 30));
+    m_liveboard->insertEntries(QVector<LiveboardEntry>() << entry("b", 20));
+    QCOMPARE(m_liveboard->rowOf("b"), 1);
+    QCOMPARE(m_liveboard->rowOf("c"), 2);
+
+    // Every row between the old and new position shifts
+    m_liveboard->updateEntry(2, entry("c", 5));
+    QCOMPARE(m_liveboard->rowOf("c"), 0);
+    QCOMPARE(m_liveboard->rowOf("a"), 1);
+    QCOMPARE(m_liveboard->rowOf("b"), 2);
+
+    // Removed vehicles are forgotten
+    m_liveboard->mergeEntries(QVector<LiveboardEntry>() << entry("a", 10) << entry("d", 40));
+    QCOMPARE(m_liveboard->rowOf("a"), 0);
+    QCOMPARE(m_liveboard->rowOf("d"), 1);
+    QCOMPARE(m_liveboard->rowOf("c"), -1);
+}
@@ -0,0 +1,50 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TESTLIVEBOARD_H
+#define TESTLIVEBOARD_H
+
+#include <QtCore/QObject>
+#include <QtCore/QDateTime>
+#include <QtCore/QVector>
+#include <QtTest/QtTest>
+
+#include "../src/models/liveboard.h"
+
+class TestLiveboard : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void insertBatched();
+    void insertBetweenExisting();
+    void mergeKeepsUnchangedRows();
+    void mergeRemovesAndReorders();
+    void mergeDuplicatedVehicle();
+    void updateMovesUp();
+    void updateMovesDown();
+    void updateInPlace();
+    void rowIndexFollowsChanges();
+
+private:
+    Liveboard *m_liveboard;
+    static LiveboardEntry entry(const QString &uri, const qint32 &minutes, const qint32 &delay = 0);
+    QStringList uris() const;
+};
+
+#endif // TESTLIVEBOARD_H
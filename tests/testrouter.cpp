@@ -0,0 +1,108 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "testrouter.h"
+
+#define TEST_ROUTE_START "2019-03-31T16:00:00Z"
+
+RouteEntry TestRouter::entry(const qint32 &departure, const qint32 &arrival, const uint &contentHash, const qint32 &delay)
+{
+    const QDateTime start = QDateTime::fromString(TEST_ROUTE_START, Qt::ISODate);
+    RouteEntry entry;
+    entry.key = qMakePair(start.addSecs(60 * departure).toMSecsSinceEpoch(),
+                          start.addSecs(60 * arrival).toMSecsSinceEpoch());
+    entry.contentHash = contentHash;
+    entry.departureTime = start.addSecs(60 * departure + delay);
+    return entry;
+}
+
+QList<qint64> TestRouter::departures() const
+{
+    QList<qint64> departures;
+    foreach (const RouteEntry &entry, m_router->m_routes) {
+        departures.append(entry.key.first);
+    }
+    return departures;
+}
+
+void TestRouter::init()
+{
+    m_router = new Router();
+}
+
+void TestRouter::cleanup()
+{
+    delete m_router;
+    m_router = nullptr;
+}
+
+void TestRouter::insertSorted()
+{
+    m_router->mergeRoute(entry(30, 90));
+    m_router->mergeRoute(entry(10, 70));
+    m_router->mergeRoute(entry(20, 80));
+
+    QCOMPARE(m_router->rowCount(QModelIndex()), 3);
+    QCOMPARE(this->departures(), QList<qint64>() << entry(10, 70).key.first
+             << entry(20, 80).key.first << entry(30, 90).key.first);
+}
+
+void TestRouter::skipDuplicates()
+{
+    m_router->mergeRoute(entry(10, 70, 1));
+    QSignalSpy inserted(m_router, SIGNAL(rowsInserted(QModelIndex, int, int)));
+    QSignalSpy changed(m_router, SIGNAL(dataChanged(QModelIndex, QModelIndex, QVector<int>)));
+
+    // Same route streamed again by an update without any change
+    QVERIFY(!m_router->mergeRoute(entry(10, 70, 1)));
+    QCOMPARE(m_router->rowCount(QModelIndex()), 1);
+    QCOMPARE(inserted.count(), 0);
+    QCOMPARE(changed.count(), 0);
+}
+
+void TestRouter::replaceInPlace()
+{
+    m_router->mergeRoute(entry(10, 70, 1));
+    m_router->mergeRoute(entry(20, 80, 1));
+    m_router->mergeRoute(entry(30, 90, 1));
+    QSignalSpy changed(m_router, SIGNAL(dataChanged(QModelIndex, QModelIndex, QVector<int>)));
+    QSignalSpy moved(m_router, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)));
+
+    // Platform changed: same key, other content hash
+    QVERIFY(m_router->mergeRoute(entry(20, 80, 2)));
+    QCOMPARE(m_router->rowCount(QModelIndex()), 3);
+    QCOMPARE(moved.count(), 0);
+    QCOMPARE(changed.count(), 1);
+    QCOMPARE(changed.at(0).at(0).value<QModelIndex>().row(), 1);
+    QCOMPARE(m_router->m_routes.at(1).contentHash, uint(2));
+}
+
+void TestRouter::replaceMoves()
+{
+    m_router->mergeRoute(entry(10, 70, 1));
+    m_router->mergeRoute(entry(20, 80, 1));
+    m_router->mergeRoute(entry(30, 90, 1));
+    QSignalSpy moved(m_router, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)));
+
+    // Delayed after the next route: the row moves, the key stays the scheduled one
+    QVERIFY(m_router->mergeRoute(entry(10, 70, 2, 25 * 60)));
+    QCOMPARE(m_router->rowCount(QModelIndex()), 3);
+    QCOMPARE(moved.count(), 1);
+    QCOMPARE(moved.at(0).at(1).toInt(), 0);
+    QCOMPARE(moved.at(0).at(4).toInt(), 3);
+    QCOMPARE(this->departures(), QList<qint64>() << entry(20, 80).key.first
+             << entry(30, 90).key.first << entry(10, 70).key.first);
+}
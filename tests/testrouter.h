@@ -0,0 +1,44 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TESTROUTER_H
+#define TESTROUTER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QDateTime>
+#include <QtTest/QtTest>
+
+#include "../src/models/router.h"
+
+class TestRouter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void insertSorted();
+    void skipDuplicates();
+    void replaceInPlace();
+    void replaceMoves();
+
+private:
+    Router *m_router;
+    static RouteEntry entry(const qint32 &departure, const qint32 &arrival, const uint &contentHash = 0, const qint32 &delay = 0);
+    QList<qint64> departures() const;
+};
+
+#endif // TESTROUTER_H
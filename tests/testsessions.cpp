@@ -0,0 +1,350 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "testsessions.h"
+
+// The dispatchers only compare these pointers, plain tags are enough to tell them apart
+#define BOARD(tag) reinterpret_cast<QRail::LiveboardEngine::Board *>(quintptr(tag))
+#define VEHICLE(tag) reinterpret_cast<QRail::VehicleEngine::Vehicle *>(quintptr(tag))
+#define JOURNEY(tag) reinterpret_cast<QRail::RouterEngine::Journey *>(quintptr(tag))
+#define TEST_STATION_A "http://irail.be/stations/NMBS/008892007"
+#define TEST_STATION_B "http://irail.be/stations/NMBS/008812005"
+#define TEST_STATION_C "http://irail.be/stations/NMBS/008814001"
+#define TEST_STATION_D "http://irail.be/stations/NMBS/008821006"
+#define TEST_UPDATE 1553950000000 // ms since epoch
+
+// Realtime update of one connection from station A to D, 10 minutes after TEST_UPDATE
+#define TEST_EVENT "{\"lc:departureStop\": \"" TEST_STATION_A "\", \"lc:arrivalStop\": \"" TEST_STATION_D "\"," \
+                   " \"lc:departureTime\": \"2019-03-30T12:56:40.000Z\", \"lc:arrivalTime\": \"2019-03-30T13:16:40.000Z\"," \
+                   " \"lc:departureDelay\": 180, \"gtfs:trip\": \"http://irail.be/vehicle/IC1832/20190330\"}"
+
+void TestSessions::initTestCase()
+{
+    qRegisterMetaType<QSharedPointer<QRail::RouterEngine::Route> >();
+    m_liveboards = LiveboardDispatcher::getInstance();
+    m_routers = RouterDispatcher::getInstance();
+}
+
+void TestSessions::init()
+{
+    m_watcher = new LiveboardSession();
+    m_other = new LiveboardSession();
+    m_querying = new LiveboardSession();
+    m_routeWatcher = new RouterSession();
+    m_routeQuerying = new RouterSession();
+}
+
+void TestSessions::cleanup()
+{
+    // The tags aren't real boards and journeys, the engines never get to see them
+    m_liveboards->m_queue.clear();
+    m_liveboards->m_refreshes.clear();
+    m_liveboards->finishActive();
+    m_liveboards->m_watches.clear();
+    m_liveboards->m_updating.clear();
+    m_liveboards->m_updateTimestamp = 0;
+    m_routers->m_queue.clear();
+    m_routers->m_refreshes.clear();
+    m_routers->m_active = nullptr;
+    m_routers->m_refreshing = nullptr;
+    m_routers->m_lastQuery.clear();
+    m_routers->m_watches.clear();
+    m_routers->m_updating.clear();
+    m_routers->m_updateTimestamp = 0;
+    delete m_watcher;
+    delete m_other;
+    delete m_querying;
+    delete m_routeWatcher;
+    delete m_routeQuerying;
+}
+
+void TestSessions::watchBoard(LiveboardSession *session, const quintptr &board, const QString &station)
+{
+    LiveboardDispatcher::Watch watch = { BOARD(board), station };
+    m_liveboards->m_watches.insert(session, watch);
+}
+
+void TestSessions::startBoard(LiveboardSession *session, const QString &station)
+{
+    m_liveboards->m_active = session;
+    m_liveboards->m_activeStation = station;
+    m_liveboards->m_activeBoard = nullptr;
+}
+
+void TestSessions::watchJourney(RouterSession *session, const quintptr &journey,
+                                const QPair<QUrl, QUrl> &stations, const QDateTime &departureTime)
+{
+    RouterDispatcher::Watch watch = { JOURNEY(journey), stations, departureTime, 4 };
+    m_routers->m_watches.insert(session, watch);
+}
+
+void TestSessions::startRoute(RouterSession *session, const QPair<QUrl, QUrl> &stations, const QDateTime &departureTime)
+{
+    RouterDispatcher::Request request = { session, stations.first, stations.second, departureTime, 4, nullptr };
+    m_routers->m_active = session;
+    m_routers->m_activeRequest = request;
+}
+
+void TestSessions::liveboardUpdateWithoutQuery()
+{
+    this->watchBoard(m_watcher, 1, TEST_STATION_A);
+    this->watchBoard(m_other, 2, TEST_STATION_B);
+    QSignalSpy updated(m_watcher, SIGNAL(updateReceived(qint64)));
+    QSignalSpy streamed(m_watcher, SIGNAL(stream(QRail::VehicleEngine::Vehicle *)));
+    QSignalSpy finished(m_watcher, SIGNAL(finished(QRail::LiveboardEngine::Board *)));
+    QSignalSpy otherUpdated(m_other, SIGNAL(updateReceived(qint64)));
+    QSignalSpy otherFinished(m_other, SIGNAL(finished(QRail::LiveboardEngine::Board *)));
+
+    m_liveboards->handleUpdateReceived(TEST_UPDATE);
+    QCOMPARE(updated.count(), 0);
+    m_liveboards->dispatchStream(VEHICLE(10), TEST_STATION_A);
+    m_liveboards->dispatchStream(VEHICLE(11), TEST_STATION_A);
+    m_liveboards->dispatchFinished(BOARD(1), TEST_STATION_A);
+
+    // Only the watcher of the updated board becomes busy, and is done again when it finished
+    QCOMPARE(updated.count(), 1);
+    QCOMPARE(updated.at(0).at(0).toLongLong(), qint64(TEST_UPDATE));
+    QCOMPARE(streamed.count(), 2);
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(otherUpdated.count(), 0);
+    QCOMPARE(otherFinished.count(), 0);
+    QVERIFY(!m_liveboards->m_active);
+}
+
+void TestSessions::liveboardUpdateDuringQuery()
+{
+    this->watchBoard(m_watcher, 1, TEST_STATION_A);
+    this->startBoard(m_querying, TEST_STATION_B);
+    QSignalSpy finished(m_watcher, SIGNAL(finished(QRail::LiveboardEngine::Board *)));
+    QSignalSpy streamed(m_watcher, SIGNAL(stream(QRail::VehicleEngine::Vehicle *)));
+    QSignalSpy queryFinished(m_querying, SIGNAL(finished(QRail::LiveboardEngine::Board *)));
+    QSignalSpy queryStreamed(m_querying, SIGNAL(stream(QRail::VehicleEngine::Vehicle *)));
+    QSignalSpy queryUpdated(m_querying, SIGNAL(updateReceived(qint64)));
+
+    m_liveboards->handleUpdateReceived(TEST_UPDATE);
+    m_liveboards->dispatchStream(VEHICLE(10), TEST_STATION_A);
+    m_liveboards->dispatchStream(VEHICLE(20), TEST_STATION_B);
+    m_liveboards->dispatchFinished(BOARD(1), TEST_STATION_A);
+
+    // The update doesn't end the running query
+    QCOMPARE(streamed.count(), 1);
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(queryStreamed.count(), 1);
+    QCOMPARE(queryFinished.count(), 0);
+    QCOMPARE(queryUpdated.count(), 0);
+    QCOMPARE(m_liveboards->m_active, m_querying);
+
+    // Its own board does
+    m_liveboards->dispatchFinished(BOARD(3), TEST_STATION_B);
+    QCOMPARE(queryFinished.count(), 1);
+    QCOMPARE(qvariant_cast<QRail::LiveboardEngine::Board *>(queryFinished.at(0).at(0)), BOARD(3));
+    QCOMPARE(finished.count(), 1);
+    QVERIFY(!m_liveboards->m_active);
+}
+
+void TestSessions::liveboardUpdateOfQueriedStation()
+{
+    // Another liveboard of the watched station is being created
+    this->watchBoard(m_watcher, 1, TEST_STATION_A);
+    this->startBoard(m_querying, TEST_STATION_A);
+    QSignalSpy finished(m_watcher, SIGNAL(finished(QRail::LiveboardEngine::Board *)));
+    QSignalSpy queryFinished(m_querying, SIGNAL(finished(QRail::LiveboardEngine::Board *)));
+
+    m_liveboards->handleUpdateReceived(TEST_UPDATE);
+    m_liveboards->dispatchFinished(BOARD(1), TEST_STATION_A);
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(queryFinished.count(), 0);
+    QCOMPARE(m_liveboards->m_active, m_querying);
+
+    m_liveboards->dispatchFinished(BOARD(2), TEST_STATION_A);
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(queryFinished.count(), 1);
+}
+
+void TestSessions::liveboardErrorEndsUpdate()
+{
+    this->watchBoard(m_watcher, 1, TEST_STATION_A);
+    this->watchBoard(m_other, 2, TEST_STATION_B);
+    QSignalSpy failed(m_watcher, SIGNAL(error(QString)));
+    QSignalSpy otherFailed(m_other, SIGNAL(error(QString)));
+
+    m_liveboards->handleUpdateReceived(TEST_UPDATE);
+    m_liveboards->dispatchStream(VEHICLE(10), TEST_STATION_A);
+    m_liveboards->handleError("Network error");
+
+    // Only busy sessions hear about it
+    QCOMPARE(failed.count(), 1);
+    QCOMPARE(otherFailed.count(), 0);
+    QVERIFY(m_liveboards->m_updating.isEmpty());
+}
+
+void TestSessions::routerUpdateWithoutQuery()
+{
+    const QDateTime departure = QDateTime::fromMSecsSinceEpoch(TEST_UPDATE, Qt::UTC);
+    const QPair<QUrl, QUrl> stations = qMakePair(QUrl(TEST_STATION_A), QUrl(TEST_STATION_B));
+    this->watchJourney(m_routeWatcher, 1, stations, departure);
+    this->watchJourney(m_routeQuerying, 2, qMakePair(QUrl(TEST_STATION_A), QUrl(TEST_STATION_C)), departure);
+    QSignalSpy updated(m_routeWatcher, SIGNAL(updateReceived(qint64)));
+    QSignalSpy streamed(m_routeWatcher, SIGNAL(stream(QSharedPointer<QRail::RouterEngine::Route>)));
+    QSignalSpy finished(m_routeWatcher, SIGNAL(finished(QRail::RouterEngine::Journey *)));
+    QSignalSpy otherUpdated(m_routeQuerying, SIGNAL(updateReceived(qint64)));
+    QSignalSpy otherStreamed(m_routeQuerying, SIGNAL(stream(QSharedPointer<QRail::RouterEngine::Route>)));
+
+    m_routers->handleUpdateReceived(TEST_UPDATE);
+    m_routers->dispatchStream(QSharedPointer<QRail::RouterEngine::Route>(), stations, departure.addSecs(600));
+    m_routers->dispatchStream(QSharedPointer<QRail::RouterEngine::Route>(), stations, departure.addSecs(-600));
+    m_routers->dispatchFinished(JOURNEY(1));
+
+    // Routes departing before the watched query don't belong to it
+    QCOMPARE(updated.count(), 1);
+    QCOMPARE(streamed.count(), 1);
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(otherUpdated.count(), 0);
+    QCOMPARE(otherStreamed.count(), 0);
+    QVERIFY(!m_routers->m_active);
+}
+
+void TestSessions::routerUpdateDuringQuery()
+{
+    const QDateTime departure = QDateTime::fromMSecsSinceEpoch(TEST_UPDATE, Qt::UTC);
+    const QPair<QUrl, QUrl> watched = qMakePair(QUrl(TEST_STATION_A), QUrl(TEST_STATION_B));
+    const QPair<QUrl, QUrl> queried = qMakePair(QUrl(TEST_STATION_C), QUrl(TEST_STATION_B));
+    this->watchJourney(m_routeWatcher, 1, watched, departure);
+    this->startRoute(m_routeQuerying, queried, departure);
+    QSignalSpy streamed(m_routeWatcher, SIGNAL(stream(QSharedPointer<QRail::RouterEngine::Route>)));
+    QSignalSpy finished(m_routeWatcher, SIGNAL(finished(QRail::RouterEngine::Journey *)));
+    QSignalSpy queryStreamed(m_routeQuerying, SIGNAL(stream(QSharedPointer<QRail::RouterEngine::Route>)));
+    QSignalSpy queryFinished(m_routeQuerying, SIGNAL(finished(QRail::RouterEngine::Journey *)));
+
+    m_routers->handleUpdateReceived(TEST_UPDATE);
+    m_routers->dispatchStream(QSharedPointer<QRail::RouterEngine::Route>(), watched, departure.addSecs(600));
+    m_routers->dispatchStream(QSharedPointer<QRail::RouterEngine::Route>(), queried, departure.addSecs(600));
+    m_routers->dispatchFinished(JOURNEY(1));
+
+    // The watched journey's routes and finished don't reach the running query
+    QCOMPARE(streamed.count(), 1);
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(queryStreamed.count(), 1);
+    QCOMPARE(queryFinished.count(), 0);
+    QCOMPARE(m_routers->m_active, m_routeQuerying);
+
+    m_routers->dispatchFinished(JOURNEY(3));
+    QCOMPARE(queryFinished.count(), 1);
+    QCOMPARE(finished.count(), 1);
+    QVERIFY(!m_routers->m_active);
+}
+
+void TestSessions::routerUpdateOfEarlierQuery()
+{
+    // Earlier and later routes of one search: the journey of every query stays watched
+    const QDateTime departure = QDateTime::fromMSecsSinceEpoch(TEST_UPDATE, Qt::UTC);
+    const QPair<QUrl, QUrl> stations = qMakePair(QUrl(TEST_STATION_A), QUrl(TEST_STATION_B));
+    this->watchJourney(m_routeWatcher, 1, stations, departure);
+    this->watchJourney(m_routeWatcher, 2, stations, departure.addSecs(3600));
+    QSignalSpy updated(m_routeWatcher, SIGNAL(updateReceived(qint64)));
+    QSignalSpy streamed(m_routeWatcher, SIGNAL(stream(QSharedPointer<QRail::RouterEngine::Route>)));
+    QSignalSpy finished(m_routeWatcher, SIGNAL(finished(QRail::RouterEngine::Journey *)));
+
+    m_routers->handleUpdateReceived(TEST_UPDATE);
+    m_routers->dispatchStream(QSharedPointer<QRail::RouterEngine::Route>(), stations, departure.addSecs(600));
+    m_routers->dispatchStream(QSharedPointer<QRail::RouterEngine::Route>(), stations, departure.addSecs(4200));
+    m_routers->dispatchFinished(JOURNEY(1));
+    QCOMPARE(updated.count(), 1);
+    QCOMPARE(streamed.count(), 2); // Once, even when both journeys match
+    QCOMPARE(finished.count(), 1);
+
+    m_routers->handleUpdateReceived(TEST_UPDATE + 60000);
+    m_routers->dispatchStream(QSharedPointer<QRail::RouterEngine::Route>(), stations, departure.addSecs(4200));
+    m_routers->dispatchFinished(JOURNEY(2));
+    QCOMPARE(updated.count(), 2);
+    QCOMPARE(finished.count(), 2);
+}
+
+void TestSessions::liveboardRefreshReplacesBoard()
+{
+    // The app's realtime transport fetched the watched board again, as a new board
+    this->watchBoard(m_watcher, 1, TEST_STATION_A);
+    this->watchBoard(m_other, 2, TEST_STATION_B);
+    m_liveboards->m_refreshing = BOARD(1);
+    m_liveboards->m_activeStation = TEST_STATION_A;
+    QSignalSpy updated(m_watcher, SIGNAL(updateReceived(qint64)));
+    QSignalSpy finished(m_watcher, SIGNAL(finished(QRail::LiveboardEngine::Board *)));
+    QSignalSpy otherFinished(m_other, SIGNAL(finished(QRail::LiveboardEngine::Board *)));
+
+    m_liveboards->handleUpdateReceived(TEST_UPDATE);
+    m_liveboards->dispatchStream(VEHICLE(10), TEST_STATION_A);
+    m_liveboards->dispatchFinished(BOARD(3), TEST_STATION_A);
+
+    QCOMPARE(updated.count(), 1);
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(finished.at(0).at(0).value<QRail::LiveboardEngine::Board *>(), BOARD(3));
+    QCOMPARE(otherFinished.count(), 0);
+    QVERIFY(!m_liveboards->m_refreshing);
+}
+
+void TestSessions::routerRefreshReplacesJourney()
+{
+    const QDateTime departure = QDateTime::fromMSecsSinceEpoch(TEST_UPDATE, Qt::UTC);
+    const QPair<QUrl, QUrl> stations = qMakePair(QUrl(TEST_STATION_A), QUrl(TEST_STATION_B));
+    this->watchJourney(m_routeWatcher, 1, stations, departure);
+    RouterDispatcher::Request request = { nullptr, stations.first, stations.second, departure, 4, JOURNEY(1) };
+    m_routers->m_refreshing = JOURNEY(1);
+    m_routers->m_activeRequest = request;
+    QSignalSpy updated(m_routeWatcher, SIGNAL(updateReceived(qint64)));
+    QSignalSpy streamed(m_routeWatcher, SIGNAL(stream(QSharedPointer<QRail::RouterEngine::Route>)));
+    QSignalSpy finished(m_routeWatcher, SIGNAL(finished(QRail::RouterEngine::Journey *)));
+
+    m_routers->handleUpdateReceived(TEST_UPDATE);
+    m_routers->dispatchStream(QSharedPointer<QRail::RouterEngine::Route>(), stations, departure.addSecs(600));
+    m_routers->dispatchFinished(JOURNEY(3));
+
+    // The new journey is watched instead of the old one, no query was running
+    QCOMPARE(updated.count(), 1);
+    QCOMPARE(streamed.count(), 1);
+    QCOMPARE(finished.count(), 1);
+    QVERIFY(!m_routers->m_refreshing);
+    QVERIFY(!m_routers->m_active);
+    QVERIFY(m_routers->isWatched(JOURNEY(3)));
+    QVERIFY(!m_routers->isWatched(JOURNEY(1)));
+}
+
+void TestSessions::liveboardRefreshOnlyTouchedBoards()
+{
+    // The update serves station A, the board of station B stays as it is
+    this->watchBoard(m_watcher, 1, TEST_STATION_A);
+    this->watchBoard(m_other, 2, TEST_STATION_B);
+    this->startBoard(m_querying, TEST_STATION_C); // Keeps the refresh queued
+
+    m_liveboards->handleRealtimeUpdate(ConnectionPage::fromJsonLd(TEST_EVENT));
+    QCOMPARE(m_liveboards->m_refreshes.length(), 1);
+    QCOMPARE(m_liveboards->m_refreshes.first().kind, LiveboardDispatcher::Refresh);
+    QCOMPARE(m_liveboards->m_refreshes.first().board, BOARD(1));
+}
+
+void TestSessions::routerRefreshOnlyTouchedJourneys()
+{
+    // Journeys from station A before the update are planned again, the later one and B to C aren't
+    const QDateTime departure = QDateTime::fromMSecsSinceEpoch(TEST_UPDATE, Qt::UTC);
+    this->watchJourney(m_routeWatcher, 1, qMakePair(QUrl(TEST_STATION_A), QUrl(TEST_STATION_B)), departure);
+    this->watchJourney(m_routeWatcher, 2, qMakePair(QUrl(TEST_STATION_A), QUrl(TEST_STATION_B)), departure.addSecs(3600));
+    this->watchJourney(m_routeQuerying, 3, qMakePair(QUrl(TEST_STATION_B), QUrl(TEST_STATION_C)), departure);
+    this->startRoute(m_routeQuerying, qMakePair(QUrl(TEST_STATION_C), QUrl(TEST_STATION_B)), departure);
+
+    m_routers->handleRealtimeUpdate(ConnectionPage::fromJsonLd(TEST_EVENT));
+    QCOMPARE(m_routers->m_refreshes.length(), 1);
+    QCOMPARE(m_routers->m_refreshes.first().journey, JOURNEY(1));
+    QVERIFY(!m_routers->m_refreshes.first().session);
+}
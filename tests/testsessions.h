@@ -0,0 +1,63 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TESTSESSIONS_H
+#define TESTSESSIONS_H
+
+#include <QtCore/QObject>
+#include <QtCore/QDateTime>
+#include <QtCore/QSharedPointer>
+#include <QtTest/QtTest>
+
+#include "../src/sessions/liveboardsession.h"
+#include "../src/sessions/routersession.h"
+
+class TestSessions : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void liveboardUpdateWithoutQuery();
+    void liveboardUpdateDuringQuery();
+    void liveboardUpdateOfQueriedStation();
+    void liveboardErrorEndsUpdate();
+    void routerUpdateWithoutQuery();
+    void routerUpdateDuringQuery();
+    void routerUpdateOfEarlierQuery();
+    void liveboardRefreshReplacesBoard();
+    void routerRefreshReplacesJourney();
+    void liveboardRefreshOnlyTouchedBoards();
+    void routerRefreshOnlyTouchedJourneys();
+
+private:
+    LiveboardDispatcher *m_liveboards;
+    RouterDispatcher *m_routers;
+    LiveboardSession *m_watcher;
+    LiveboardSession *m_other;
+    LiveboardSession *m_querying;
+    RouterSession *m_routeWatcher;
+    RouterSession *m_routeQuerying;
+    void watchBoard(LiveboardSession *session, const quintptr &board, const QString &station);
+    void startBoard(LiveboardSession *session, const QString &station);
+    void watchJourney(RouterSession *session, const quintptr &journey,
+                      const QPair<QUrl, QUrl> &stations, const QDateTime &departureTime);
+    void startRoute(RouterSession *session, const QPair<QUrl, QUrl> &stations, const QDateTime &departureTime);
+};
+
+#endif // TESTSESSIONS_H
@@ -0,0 +1,113 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "teststationindex.h"
+
+void TestStationIndex::initTestCase()
+{
+    // The index never dereferences its stations, plain tags are enough to tell them apart
+    for (quintptr s = 0; s < 5; s++) {
+        m_stations.append(reinterpret_cast<QRail::StationEngine::Station *>(s + 1));
+    }
+
+    QVector<QStringList> names;
+    names << (QStringList() << StationIndex::normalize("Gent-Sint-Pieters") << StationIndex::normalize("Gand-Saint-Pierre"));
+    names << (QStringList() << StationIndex::normalize("Gentbrugge"));
+    names << (QStringList() << StationIndex::normalize("Brussel-Zuid") << StationIndex::normalize("Bruxelles-Midi"));
+    names << (QStringList() << StationIndex::normalize("Liège-Guillemins"));
+    names << (QStringList() << StationIndex::normalize("Sint-Gillis"));
+
+    m_positions << QGeoCoordinate(51.0359, 3.7108) // Gent-Sint-Pieters
+                << QGeoCoordinate(51.0382, 3.7567) // Gentbrugge
+                << QGeoCoordinate(50.8357, 4.3363) // Brussel-Zuid
+                << QGeoCoordinate(50.6245, 5.5668) // Liège-Guillemins
+                << QGeoCoordinate(50.8262, 4.3453); // Sint-Gillis
+
+    m_index = new StationIndex();
+    m_index->m_index = StationIndex::buildIndex(m_stations, names, m_positions);
+}
+
+void TestStationIndex::cleanupTestCase()
+{
+    delete m_index;
+    m_index = nullptr;
+}
+
+QList<QRail::StationEngine::Station *> TestStationIndex::search(const QString &query) const
+{
+    return m_index->search(query);
+}
+
+void TestStationIndex::normalize()
+{
+    QCOMPARE(StationIndex::normalize("  Liège  Guillemins "), QString("liege guillemins"));
+    QCOMPARE(StationIndex::normalize("BRUXELLES"), QString("bruxelles"));
+}
+
+void TestStationIndex::searchPrefix()
+{
+    // Short queries use the sorted prefixes: complete names and every word after the first
+    QCOMPARE(this->search("ge"), QList<QRail::StationEngine::Station *>() << m_stations.at(0) << m_stations.at(1));
+    QCOMPARE(this->search("Zu"), QList<QRail::StationEngine::Station *>() << m_stations.at(2));
+    QVERIFY(this->search("").isEmpty());
+}
+
+void TestStationIndex::searchTrigrams()
+{
+    QCOMPARE(this->search("guillemins"), QList<QRail::StationEngine::Station *>() << m_stations.at(3));
+    QCOMPARE(this->search("liege"), QList<QRail::StationEngine::Station *>() << m_stations.at(3));
+    QCOMPARE(this->search("midi"), QList<QRail::StationEngine::Station *>() << m_stations.at(2));
+    QVERIFY(this->search("antwerpen").isEmpty());
+}
+
+void TestStationIndex::searchRanking()
+{
+    // Name prefix first, then a word prefix
+    QCOMPARE(this->search("sint"), QList<QRail::StationEngine::Station *>() << m_stations.at(4) << m_stations.at(0));
+}
+
+void TestStationIndex::searchCanceled()
+{
+    QAtomicInt generation(2);
+    QVERIFY(m_index->search("sint", &generation, 1).isEmpty());
+    QCOMPARE(m_index->search("sint", &generation, 2).length(), 2);
+}
+
+void TestStationIndex::gridNearest()
+{
+    StationGrid grid;
+    grid.build(m_positions);
+
+    // Brussels: Sint-Gillis and Brussel-Zuid are closest, Gent and Liège are several cells away
+    QVector<QPair<qint32, qreal> > nearest = grid.nearest(QGeoCoordinate(50.8300, 4.3400), 3);
+    QCOMPARE(nearest.length(), 3);
+    QCOMPARE(nearest.at(0).first, 4);
+    QCOMPARE(nearest.at(1).first, 2);
+    QVERIFY(nearest.at(0).second <= nearest.at(1).second);
+    QVERIFY(nearest.at(1).second <= nearest.at(2).second);
+
+    // Everything when more stations are asked than there are
+    QCOMPARE(grid.nearest(QGeoCoordinate(51.0, 3.7), 10).length(), m_positions.length());
+}
+
+void TestStationIndex::gridEmpty()
+{
+    StationGrid grid;
+    QVERIFY(grid.nearest(QGeoCoordinate(50.8300, 4.3400), 3).isEmpty());
+    grid.build(m_positions);
+    QVERIFY(grid.nearest(QGeoCoordinate(), 3).isEmpty());
+    QVERIFY(grid.nearest(QGeoCoordinate(50.8300, 4.3400), 0).isEmpty());
+}
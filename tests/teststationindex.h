@@ -0,0 +1,51 @@
+/*
+*   This file is part of LCRail.
+*
+*   LCRail is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   LCRail is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with LCRail.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TESTSTATIONINDEX_H
+#define TESTSTATIONINDEX_H
+
+#include <QtCore/QObject>
+#include <QtCore/QVector>
+#include <QtCore/QStringList>
+#include <QtPositioning/QGeoCoordinate>
+#include <QtTest/QtTest>
+
+#include "../src/models/stationindex.h"
+#include "../src/models/stationgrid.h"
+
+class TestStationIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void normalize();
+    void searchPrefix();
+    void searchTrigrams();
+    void searchRanking();
+    void searchCanceled();
+    void gridNearest();
+    void gridEmpty();
+
+private:
+    StationIndex *m_index;
+    QVector<QRail::StationEngine::Station *> m_stations;
+    QVector<QGeoCoordinate> m_positions;
+    QList<QRail::StationEngine::Station *> search(const QString &query) const;
+};
+
+#endif // TESTSTATIONINDEX_H